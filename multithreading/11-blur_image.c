@@ -4,136 +4,93 @@
 #include <string.h>
 #include "10-blur_portion.c"
 
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
-#define MIN(a, b) ((a) < (b) ? (a) : (b))
-#define NUM_PIXELS(img) ((img)->w * (img)->h)
-#define PORTION_END_INDEX(p) (((p)->y + (p)->h) * (p)->img->w)
-#define PORTION_START_INDEX(p) ((p)->y * (p)->img->w + (p)->x)
-#define MAX_THREADS 16
-
 /**
- * blur_image - Applies Gaussian Blur to the entire image
+ * struct blur_job_s - Context of a parallel blur
  * @img_blur: Address where the blurred image will be stored
  * @img: Original image to be blurred
  * @kernel: Convolution kernel to be used for blurring
- * Author: Frank Onyema Orji
+ * @stride: Distance between the rows of @img, in pixels
+ * @stride_blur: Distance between the rows of @img_blur, in pixels
  */
-void blur_image(img_t *img_blur, img_t const *img, kernel_t const *kernel)
+typedef struct blur_job_s
 {
-	size_t i, num_portions;
-	blur_portion_t *portions;
-	pthread_t *threads;
-
-	num_portions = divide_image_into_portions(&portions, img_blur, img, kernel);
-
-	/* Create threads */
-	threads = malloc(sizeof(pthread_t) * num_portions);
-	for (i = 0; i < num_portions; i++)
-	{
-		/* Each thread will call blur_portion_mt(&portions[i]) */
-		pthread_create(&threads[i], NULL, &blur_portion_mt, &portions[i]);
-	}
-
-	/* Wait for threads to finish */
-	for (i = 0; i < num_portions; i++)
-	{
-		pthread_join(threads[i], NULL);
-	}
-
-	/* Clean up */
-	free(portions);
-	free(threads);
-}
+	img_t *img_blur;
+	img_t const *img;
+	kernel_t const *kernel;
+	size_t stride;
+	size_t stride_blur;
+} blur_job_t;
 
 /**
- * divide_image_into_portions - Splits an image into portions for processing
- * @portions: Array of portions to fill
- * @img_blur: Pointer to the blurred image
- * @img: Pointer to the original image
- * @kernel: Pointer to the convolution kernel
- * Return: Number of portions
+ * blur_rows - Blurs a band of full-width rows of an image
+ * @rows: Rows to blur
+ * @ctx: Pointer to the blur_job_t
  */
-size_t divide_image_into_portions(blur_portion_t **portions, img_t *img_blur,
-								  img_t const *img, kernel_t const *kernel)
+static void blur_rows(range_t const *rows, void *ctx)
 {
-	size_t portion_grid_size = calculate_portion_grid_size(MAX_THREADS);
-	size_t num_portions = portion_grid_size * portion_grid_size;
-	size_t i, x, y, w, h, remainder;
-
-	*portions = malloc(sizeof(blur_portion_t) * num_portions);
-	if (*portions == NULL)
-		return 0;
-
-	w = MAX(img->w / portion_grid_size, 1);
-	for (i = 0, x = 0; x < img->w; x += w)
-	{
-		h = MAX(img->h / portion_grid_size, 1);
-		remainder = img->w - (x + w);
-		if (remainder && remainder < w)
-			w += remainder;
-
-		for (y = 0; y < img->h; y += h)
-		{
-			remainder = img->h - (y + h);
-			if (remainder && remainder < h)
-				h += remainder;
-
-			initialize_portion(&(*portions)[i], img_blur, img, kernel, x, y, w, h);
-			i++;
-		}
-	}
-
-	return num_portions;
+	blur_job_t const *job = ctx;
+	blur_portion_t portion;
+
+	portion.img = job->img;
+	portion.img_blur = job->img_blur;
+	portion.kernel = job->kernel;
+	portion.x = 0;
+	portion.y = rows->begin;
+	portion.w = job->img->w;
+	portion.h = rows->end - rows->begin;
+	blur_portion_strided(&portion, job->stride, job->stride_blur);
 }
 
 /**
- * calculate_portion_grid_size - Determines the grid size based on the max thread count
- * @max_threads: Maximum number of threads allowed
- * Return: Grid size for the portions
+ * blur_job_run - Blurs an image as bands of rows spread over the
+ * parallel_for pool
+ * @job: Blur, with its images, kernel and strides set
  */
-size_t calculate_portion_grid_size(size_t max_threads)
+static void blur_job_run(blur_job_t *job)
 {
-	size_t n = 1;
-
-	while (n * n <= max_threads)
-		n++;
+	range_t rows;
 
-	return n - 1;
+	rows.begin = 0;
+	rows.end = job->img->h;
+	parallel_for(rows, 0, blur_rows, job);
 }
 
 /**
- * initialize_portion - Initializes a portion of the image
- * @portion: Pointer to the portion to initialize
- * @img_blur: Pointer to the image to be blurred
- * @img: Pointer to the original image
- * @kernel: Pointer to the convolution kernel
- * @x: X-coordinate of the portion
- * @y: Y-coordinate of the portion
- * @w: Width of the portion
- * @h: Height of the portion
+ * blur_image - Applies Gaussian Blur to the entire image, as bands of rows
+ * spread over the parallel_for pool
+ * @img_blur: Address where the blurred image will be stored
+ * @img: Original image to be blurred
+ * @kernel: Convolution kernel to be used for blurring
+ * Author: Frank Onyema Orji
  */
-void initialize_portion(blur_portion_t *portion, img_t *img_blur, img_t const *img,
-						kernel_t const *kernel, size_t x, size_t y, size_t w, size_t h)
+void blur_image(img_t *img_blur, img_t const *img, kernel_t const *kernel)
 {
-	if (portion)
-	{
-		portion->img = img;
-		portion->img_blur = img_blur;
-		portion->kernel = kernel;
-		portion->x = x;
-		portion->y = y;
-		portion->w = w;
-		portion->h = h;
-	}
+	blur_job_t job;
+
+	job.img_blur = img_blur;
+	job.img = img;
+	job.kernel = kernel;
+	job.stride = img->w;
+	job.stride_blur = img_blur->w;
+	blur_job_run(&job);
 }
 
 /**
- * blur_portion_mt - Wrapper for blur_portion to be used in multithreading
- * @portion: Pointer to the portion structure describing the image portion to blur
- * Return: NULL
+ * blur_image_buf - Applies Gaussian Blur to an entire image allocated by
+ * img_alloc, whose rows are padded
+ * @img_blur: Image where the blurred image will be stored
+ * @img: Original image to be blurred
+ * @kernel: Convolution kernel to be used for blurring
  */
-void *blur_portion_mt(void *portion)
+void blur_image_buf(img_buf_t *img_blur, img_buf_t const *img,
+		    kernel_t const *kernel)
 {
-	blur_portion((blur_portion_t const *)portion);
-	pthread_exit(NULL);
+	blur_job_t job;
+
+	job.img_blur = &img_blur->img;
+	job.img = &img->img;
+	job.kernel = kernel;
+	job.stride = img->stride;
+	job.stride_blur = img_blur->stride;
+	blur_job_run(&job);
 }
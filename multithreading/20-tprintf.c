@@ -4,7 +4,8 @@
 
 /**
  * tprintf - uses printf family to print out a given formatted string
- * uses mutex to prevent race conditions
+ * uses mutex to prevent race conditions, or the calling thread's buffer
+ * when buffered mode is on (see tprintf_set_buffered)
  * @format: formatted string
  * Return: number of characters printed
  * Frank Onyema Orji
@@ -16,6 +17,12 @@ int tprintf(char const *format, ...)
 	int chars_printed;
 
 	va_start(args, format);
+	if (tprintf_is_buffered())
+	{
+		chars_printed = vtprintf_buffered(format, args);
+		va_end(args);
+		return (chars_printed);
+	}
 	pthread_mutex_lock(&tprintf_mutex);
 	chars_printed = printf("[%lu] ", (unsigned long)self);
 	chars_printed += vprintf(format, args);
@@ -29,7 +36,7 @@ __attribute__((constructor)) void tprintf_mutex_init(void)
 	pthread_mutex_init(&tprintf_mutex, NULL);
 }
 
-__attribute__((destructor)) void tprintf_mutex_destroy(void)
+__attribute__((destructor(101))) void tprintf_mutex_destroy(void)
 {
 	pthread_mutex_destroy(&tprintf_mutex);
 }
@@ -1,35 +1,30 @@
 #include "multithreading.h"
+#include "factor.h"
 #include <stdlib.h>
 
 /**
  * prime_factors - factors a number into a list of prime factors
  * @s: string representation of the number to factor
- * Return: list_t of prime factors
+ * Return: list_t of prime factors, in ascending order, or NULL if the
+ * running task was cancelled
  **/
 list_t *prime_factors(char const *s)
 {
-	unsigned long n = strtoul(s, NULL, 10);
-	unsigned long *tmp, p = 2;
-	list_t *list = malloc(sizeof(list_t));
+	uint64_t factors[FACTORS_MAX];
+	size_t i, count = factor_u64(strtoul(s, NULL, 10), factors);
+	unsigned long *tmp;
+	list_t *list;
 
+	if (count == FACTORS_CANCELLED)
+		return (NULL);
+	list = malloc(sizeof(list_t));
+	if (!list)
+		return (NULL);
 	list_init(list);
-	while (p * p <= n)
-	{
-		while (n % p == 0)
-		{
-			tmp = malloc(sizeof(unsigned long));
-			*tmp = p;
-			list_add(list, (void *)tmp);
-			n /= p;
-		}
-
-		p += 1 + (p != 2);
-	}
-
-	if (n >= 2)
+	for (i = 0; i < count; i++)
 	{
 		tmp = malloc(sizeof(unsigned long));
-		*tmp = n;
+		*tmp = factors[i];
 		list_add(list, (void *)tmp);
 	}
 	return (list);
@@ -1,5 +1,6 @@
 #include "multithreading.h"
 #include "22-prime_factors_helpers.c"
+#include "topology.h"
 #include <stdlib.h>
 
 /*
@@ -37,6 +38,14 @@ task_t *create_task(task_entry_t entry, void *param)
 		task->status = PENDING;
 		task->result = NULL;
 		task->id = id++;
+		task->free_result = NULL;
+		task->enqueued_ns = task_clock_ns();
+		task->priority = TASK_PRIO_NORMAL;
+		task->deadline_ns = 0;
+		atomic_init(&task->cancelled, 0);
+		task->timeout_ns = 0;
+		task->timer_slot = 0;
+		task->wake_fd = -1;
 	}
 
 	return (task);
@@ -48,14 +57,92 @@ task_t *create_task(task_entry_t entry, void *param)
  **/
 void destroy_task(task_t *task)
 {
-	if (task)
+	if (task && task->free_result)
 	{
-		list_destroy(task->result, free);
+		task->free_result(task->result);
+		free(task);
+	}
+	else if (task)
+	{
+		if (task->result)
+			list_destroy(task->result, free);
 		free(task->result);
 		free(task);
 	}
 }
 
+/**
+ * run_task - executes a claimed task, recording its queue wait and run time;
+ * the task is cancelled if it runs past its timeout
+ * @task: task claimed by the calling thread
+ * @stats: metrics of the calling thread, or NULL
+ * @verbose: whether to log the start and completion of the task
+ **/
+void run_task(task_t *task, task_worker_stats_t *stats, int verbose)
+{
+	static char const *const logs[TASK_STATUS_MAX] = {
+		NULL, NULL, "[%02d] Success\n", "[%02d] Failure\n",
+		"[%02d] Cancelled\n"
+	};
+	uint64_t start = task_clock_ns(), end;
+	int task_id = task->id, timed = 0;
+	task_status_t status;
+
+	if (verbose)
+		tprintf("[%02d] Started\n", task_id);
+	if (task->timeout_ns)
+		timed = !task_timer_arm(task);
+	cancel_current = &task->cancelled;
+	status = exec_task(task) ? SUCCESS : FAILURE;
+	cancel_current = NULL;
+	if (timed)
+		task_timer_disarm(task);
+	if (atomic_load(&task->cancelled))
+		status = CANCELLED;
+	set_task_status(task, status);
+	if (verbose)
+		tprintf(logs[status], task_id);
+	if (!stats)
+		return;
+	end = task_clock_ns();
+	task_hist_record(&stats->wait, start - task->enqueued_ns);
+	task_hist_record(&stats->run, end - start);
+	if (!atomic_load_explicit(&stats->tasks, memory_order_relaxed))
+		atomic_store_explicit(&stats->first_ns, start,
+				      memory_order_relaxed);
+	atomic_store_explicit(&stats->last_ns, end, memory_order_relaxed);
+	task_stats_add(&stats->tasks, 1);
+}
+
+/**
+ * run_tasks - executes every pending task of a list; the worker is pinned
+ * to a CPU when TASK_PIN is set
+ * @tasks: list of tasks
+ * @verbose: whether to log the start and completion of each task
+ **/
+static void run_tasks(list_t const *tasks, int verbose)
+{
+	task_worker_stats_t *stats = task_stats_worker();
+	int tasks_pending = 1;
+	uint64_t scan;
+	node_t *node;
+
+	topology_pin_worker();
+	while (tasks_pending)
+	{
+		scan = task_clock_ns();
+		for (tasks_pending = 0, node = tasks->head; node;
+		     node = node->next)
+			if (claim_task(node->content))
+			{
+				tasks_pending = 1;
+				run_task(node->content, stats, verbose);
+			}
+		if (!tasks_pending && stats)
+			task_stats_add(&stats->idle_ns, task_clock_ns() - scan);
+	}
+}
+
 /**
  * exec_tasks - executes a list of tasks
  * @tasks: NULL-terminated list of tasks
@@ -63,31 +150,22 @@ void destroy_task(task_t *task)
  **/
 void *exec_tasks(list_t const *tasks)
 {
-	int tasks_pending = 1, task_id;
-	node_t *node;
-
 	if (tasks == NULL)
 		pthread_exit(NULL);
 
-	while (tasks_pending)
-		for (tasks_pending = 0, node = tasks->head; node; node = node->next)
-			if (get_task_status(node->content) == PENDING)
-			{
-				tasks_pending = 1;
-				task_id = ((task_t *)node->content)->id;
-				set_task_status(node->content, STARTED);
-				tprintf("[%02d] Started\n", task_id);
-				if (exec_task(node->content))
-				{
-					set_task_status(node->content, SUCCESS);
-					tprintf("[%02d] Success\n", task_id);
-				}
-				else
-				{
-					set_task_status(node->content, FAILURE);
-					tprintf("[%02d] Failure\n", task_id);
-				}
-			}
+	run_tasks(tasks, 1);
+	return (NULL);
+}
 
+/**
+ * exec_tasks_quiet - executes a list of tasks without logging them, for
+ * internal workloads such as the benchmarks
+ * @tasks: list of tasks
+ * Return: NULL
+ **/
+void *exec_tasks_quiet(list_t const *tasks)
+{
+	if (tasks)
+		run_tasks(tasks, 0);
 	return (NULL);
 }
@@ -48,3 +48,21 @@ void set_task_status(task_t *task, task_status_t status)
 	task->status = status;
 	pthread_mutex_unlock(&task->lock);
 }
+
+/**
+ * claim_task - atomically moves a task from PENDING to STARTED, so that a
+ * task is only ever executed by one thread; thread-safe
+ * @task: task
+ * Return: 1 if the calling thread claimed the task, 0 otherwise
+ */
+int claim_task(task_t *task)
+{
+	int claimed;
+
+	pthread_mutex_lock(&task->lock);
+	claimed = task->status == PENDING;
+	if (claimed)
+		task->status = STARTED;
+	pthread_mutex_unlock(&task->lock);
+	return (claimed);
+}
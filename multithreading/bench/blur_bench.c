@@ -0,0 +1,198 @@
+#include "../multithreading.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Blurs the same random image in three kinds of buffers:
+ *
+ *  malloc   plain malloc'd pixels, rows packed, with blur_image
+ *  thp      img_alloc(IMG_HUGEPAGE): transparent huge pages, aligned rows,
+ *           with blur_image_buf
+ *  hugetlb  img_alloc(IMG_HUGETLB): reserved huge pages (vm.nr_hugepages),
+ *           or the thp layout when none is available
+ *
+ * make bench_blur (or see the Makefile for the sources)
+ * ./blur_bench [width] [height] [kernel_size]
+ *
+ * Each time is the best of BLUR_RUNS, and every blurred image must match
+ * the malloc one.
+ */
+
+#define BLUR_RUNS 3
+
+/**
+ * elapsed - Measures the time since a starting point
+ *
+ * @start: Starting point
+ *
+ * Return: Elapsed time, in seconds
+ */
+static double elapsed(struct timespec const *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start->tv_sec) +
+		(end.tv_nsec - start->tv_nsec) / 1e9);
+}
+
+/**
+ * kernel_create - Builds a Gaussian kernel
+ *
+ * @kernel: Kernel to fill
+ * @size:   Odd size of the matrix
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int kernel_create(kernel_t *kernel, size_t size)
+{
+	double sigma = size / 6.0 + 0.5;
+	size_t i, j;
+	long di, dj;
+
+	kernel->size = size;
+	kernel->matrix = calloc(size, sizeof(*kernel->matrix));
+	if (!kernel->matrix)
+		return (-1);
+	for (i = 0; i < size; i++)
+	{
+		kernel->matrix[i] = malloc(sizeof(**kernel->matrix) * size);
+		if (!kernel->matrix[i])
+			return (-1);
+		for (j = 0; j < size; j++)
+		{
+			di = (long)i - (long)size / 2;
+			dj = (long)j - (long)size / 2;
+			kernel->matrix[i][j] = exp(-(di * di + dj * dj) /
+						   (2 * sigma * sigma));
+		}
+	}
+	return (0);
+}
+
+/**
+ * img_copy - Copies the pixels of a packed image into an img_alloc one of
+ *            the same size
+ *
+ * @dst: Destination
+ * @src: Source
+ */
+static void img_copy(img_buf_t *dst, img_t const *src)
+{
+	size_t y;
+
+	for (y = 0; y < src->h; y++)
+		memcpy(dst->img.pixels + y * dst->stride,
+		       src->pixels + y * src->w, src->w * sizeof(pixel_t));
+}
+
+/**
+ * img_equal - Compares the pixels of an img_alloc image and a packed image
+ *             of the same size
+ *
+ * @a: Image
+ * @b: Image
+ *
+ * Return: 1 if they match, 0 otherwise
+ */
+static int img_equal(img_buf_t const *a, img_t const *b)
+{
+	size_t y;
+
+	for (y = 0; y < b->h; y++)
+		if (memcmp(a->img.pixels + y * a->stride, b->pixels + y * b->w,
+			   b->w * sizeof(pixel_t)))
+			return (0);
+	return (1);
+}
+
+/**
+ * time_blur - Times blur_image, or blur_image_buf, best of BLUR_RUNS
+ *
+ * @img_blur: Destination image
+ * @img:      Source image
+ * @kernel:   Kernel
+ * @padded:   Whether the images come from img_alloc, as img_buf_t
+ *
+ * Return: Time, in seconds
+ */
+static double time_blur(void *img_blur, void const *img,
+			kernel_t const *kernel, int padded)
+{
+	struct timespec start;
+	double best = 0, t;
+	int run;
+
+	for (run = 0; run < BLUR_RUNS; run++)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (padded)
+			blur_image_buf(img_blur, img, kernel);
+		else
+			blur_image(img_blur, img, kernel);
+		t = elapsed(&start);
+		if (!run || t < best)
+			best = t;
+	}
+	return (best);
+}
+
+/**
+ * main - Entry point
+ *
+ * @ac: Arguments count
+ * @av: Arguments vector
+ *
+ * Return: EXIT_SUCCESS, or EXIT_FAILURE on error
+ */
+int main(int ac, char **av)
+{
+	size_t w = ac > 1 ? strtoul(av[1], NULL, 10) : 4096;
+	size_t h = ac > 2 ? strtoul(av[2], NULL, 10) : 4096;
+	size_t size = ac > 3 ? strtoul(av[3], NULL, 10) | 1 : 9, i;
+	char const *names[] = {"thp", "hugetlb"};
+	int flags[] = {IMG_HUGEPAGE, IMG_HUGETLB};
+	img_buf_t img, img_blur;
+	img_t src, ref;
+	kernel_t kernel;
+	double t;
+
+	src.w = ref.w = w, src.h = ref.h = h;
+	src.pixels = malloc(sizeof(pixel_t) * w * h);
+	ref.pixels = malloc(sizeof(pixel_t) * w * h);
+	if (!src.pixels || !ref.pixels || kernel_create(&kernel, size))
+		return (EXIT_FAILURE);
+	srand(42);
+	for (i = 0; i < w * h; i++)
+	{
+		src.pixels[i].r = rand();
+		src.pixels[i].g = rand();
+		src.pixels[i].b = rand();
+	}
+	printf("%lux%lu, kernel %lu\n", (unsigned long)w, (unsigned long)h,
+	       (unsigned long)size);
+	t = time_blur(&ref, &src, &kernel, 0);
+	printf("%-8s %8.3f s %10.2f Mpixels/s\n", "malloc", t, w * h / t / 1e6);
+	for (i = 0; i < sizeof(flags) / sizeof(*flags); i++)
+	{
+		if (img_alloc(&img, w, h, flags[i]) ||
+		    img_alloc(&img_blur, w, h, flags[i]))
+			return (EXIT_FAILURE);
+		img_copy(&img, &src);
+		t = time_blur(&img_blur, &img, &kernel, 1);
+		if (!img_equal(&img_blur, &ref))
+			return (EXIT_FAILURE);
+		printf("%-8s %8.3f s %10.2f Mpixels/s\n", names[i], t,
+		       w * h / t / 1e6);
+		img_free(&img);
+		img_free(&img_blur);
+	}
+	for (i = 0; i < size; i++)
+		free(kernel.matrix[i]);
+	free(kernel.matrix);
+	free(src.pixels);
+	free(ref.pixels);
+	return (EXIT_SUCCESS);
+}
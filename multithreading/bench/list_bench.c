@@ -0,0 +1,166 @@
+#include "../list.h"
+#include "../ulist.h"
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Compares append and traversal throughput of the doubly-linked list_t
+ * against the unrolled ulist_t.
+ *
+ * gcc -O2 -Wall -Wextra -Werror -pedantic list_bench.c ../list.c \
+ *	../ulist.c -o list_bench
+ * ./list_bench [elements] [rounds]
+ *
+ * The "list_t, scattered" row links nodes made by node_create between
+ * other allocations, as in a long-running heap, where each node is a
+ * likely cache miss.
+ */
+
+#define NUM_KINDS 3
+
+static volatile unsigned long sink;
+
+/**
+ * elapsed - Measures the time since a starting point
+ *
+ * @start: Starting point
+ *
+ * Return: Elapsed time, in nanoseconds
+ */
+static double elapsed(struct timespec const *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start->tv_sec) * 1e9 +
+		(end.tv_nsec - start->tv_nsec));
+}
+
+/**
+ * build_scattered - Builds a list_t from nodes allocated one by one, each
+ *                   followed by a filler allocation
+ *
+ * @list:    List to fill
+ * @count:   Number of elements
+ * @fillers: Array receiving the filler allocations
+ */
+static void build_scattered(list_t *list, size_t count, void **fillers)
+{
+	node_t *node;
+	size_t i;
+
+	list_init(list);
+	for (i = 0; i < count; i++)
+	{
+		node = node_create((void *)i);
+		fillers[i] = malloc(48 + (i * 7919 % 5) * 16);
+		node->prev = list->tail;
+		if (list->tail)
+			list->tail->next = node;
+		else
+			list->head = node;
+		list->tail = node;
+		list->size++;
+	}
+}
+
+/**
+ * bench_list - Times a list_t
+ *
+ * @count:     Number of elements
+ * @scattered: Whether to build the list from scattered nodes
+ * @add_ns:    Where to add the append time
+ * @walk_ns:   Where to add the traversal time
+ */
+static void bench_list(size_t count, int scattered, double *add_ns,
+		       double *walk_ns)
+{
+	void **fillers = scattered ? malloc(sizeof(void *) * count) : NULL;
+	struct timespec start;
+	unsigned long sum = 0;
+	node_t const *node;
+	list_t list;
+	size_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (fillers)
+		build_scattered(&list, count, fillers);
+	else
+		for (list_init(&list), i = 0; i < count; i++)
+			list_add(&list, (void *)i);
+	*add_ns += elapsed(&start);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (node = list.head; node; node = node->next)
+		sum += (unsigned long)node->content;
+	*walk_ns += elapsed(&start);
+	sink = sum;
+	list_destroy(&list, NULL);
+	for (i = 0; fillers && i < count; i++)
+		free(fillers[i]);
+	free(fillers);
+	if (scattered)
+		malloc_trim(0); /* Consolidates the freed chunks, untimed */
+}
+
+/**
+ * bench_ulist - Times a ulist_t
+ *
+ * @count:   Number of elements
+ * @add_ns:  Where to add the append time
+ * @walk_ns: Where to add the traversal time
+ */
+static void bench_ulist(size_t count, double *add_ns, double *walk_ns)
+{
+	struct timespec start;
+	unsigned long sum = 0;
+	ulist_iter_t iter;
+	ulist_t list;
+	void *content;
+	size_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (ulist_init(&list), i = 0; i < count; i++)
+		ulist_add(&list, (void *)i);
+	*add_ns += elapsed(&start);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (ulist_iter_init(&iter, &list); ulist_next(&iter, &content);)
+		sum += (unsigned long)content;
+	*walk_ns += elapsed(&start);
+	sink = sum;
+	ulist_destroy(&list, NULL);
+}
+
+/**
+ * main - Entry point
+ *
+ * @ac: Arguments count
+ * @av: Arguments vector
+ *
+ * Return: EXIT_SUCCESS
+ */
+int main(int ac, char **av)
+{
+	static char const *const names[NUM_KINDS] = {
+		"list_t, slabs", "list_t, scattered", "ulist_t"
+	};
+	size_t count = ac > 1 ? strtoul(av[1], NULL, 10) : 1000000;
+	size_t rounds = ac > 2 ? strtoul(av[2], NULL, 10) : 5, r;
+	double add[NUM_KINDS] = {0}, walk[NUM_KINDS] = {0};
+	int k;
+
+	if (!count || !rounds)
+		return (EXIT_FAILURE);
+	for (r = 0; r < rounds; r++)
+	{
+		bench_list(count, 0, &add[0], &walk[0]);
+		bench_list(count, 1, &add[1], &walk[1]);
+		bench_ulist(count, &add[2], &walk[2]);
+	}
+	printf("%-20s %14s %14s\n", "list", "add (ns/elem)", "walk (ns/elem)");
+	for (k = 0; k < NUM_KINDS; k++)
+		printf("%-20s %14.2f %14.2f\n", names[k],
+		       add[k] / (count * rounds), walk[k] / (count * rounds));
+	return (EXIT_SUCCESS);
+}
@@ -0,0 +1,181 @@
+#include "../factor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Compares factor_u64 (Miller-Rabin + Pollard-Brent rho) against the
+ * original trial division of prime_factors.
+ *
+ * gcc -O2 -Wall -Wextra -Werror -pedantic prime_factors_bench.c \
+ *	../factor_montgomery.c ../factor_rho.c ../prime_sieve.c -pthread \
+ *	-o prime_factors_bench
+ * ./prime_factors_bench [numbers_per_class] [-a]
+ *
+ * -a also runs trial division on the 62-bit semiprimes (seconds each).
+ */
+
+#define NUM_CLASSES 4
+
+/**
+ * struct bench_class_s - Class of numbers to factor
+ *
+ * @name:      Display name
+ * @bits:      Size of the numbers (or of each prime for semiprimes)
+ * @semiprime: Whether the numbers are products of two primes
+ * @slow:      Whether trial division is only run with -a
+ */
+typedef struct bench_class_s
+{
+	char const *name;
+	int bits;
+	int semiprime;
+	int slow;
+} bench_class_t;
+
+/**
+ * rand_u64 - xorshift64 pseudo random generator
+ *
+ * @state: Generator state
+ *
+ * Return: Next pseudo random number
+ */
+static uint64_t rand_u64(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return (*state);
+}
+
+/**
+ * trial_factor - Original trial division algorithm of prime_factors
+ *
+ * @n:       Number to factor
+ * @factors: Array to store the factors
+ *
+ * Return: Number of factors
+ */
+static size_t trial_factor(uint64_t n, uint64_t *factors)
+{
+	size_t count = 0;
+	uint64_t p = 2;
+
+	while (p * p <= n)
+	{
+		while (n % p == 0)
+		{
+			factors[count++] = p;
+			n /= p;
+		}
+		p += 1 + (p != 2);
+	}
+	if (n >= 2)
+		factors[count++] = n;
+	return (count);
+}
+
+/**
+ * make_number - Generates a number of a given class
+ *
+ * @class: Class of the number
+ * @state: Generator state
+ *
+ * Return: Generated number
+ */
+static uint64_t make_number(bench_class_t const *class, uint64_t *state)
+{
+	uint64_t mask = class->bits == 64 ? ~0UL : (1UL << class->bits) - 1;
+	uint64_t p, q;
+
+	if (!class->semiprime)
+		return ((rand_u64(state) & mask) | 1UL << (class->bits - 1));
+	p = (rand_u64(state) & mask) | 1UL << (class->bits - 1) | 1;
+	while (!is_prime_u64(p))
+		p += 2;
+	q = (rand_u64(state) & mask) | 1UL << (class->bits - 1) | 1;
+	while (!is_prime_u64(q))
+		q += 2;
+	return (p * q);
+}
+
+/**
+ * run - Times a factoring function over a set of numbers
+ *
+ * @fn:      Factoring function
+ * @numbers: Numbers to factor
+ * @count:   Number of numbers
+ * @sum:     Checksum of the factors, to compare implementations
+ *
+ * Return: Elapsed time, in seconds
+ */
+static double run(size_t (*fn)(uint64_t, uint64_t *), uint64_t const *numbers,
+		  size_t count, uint64_t *sum)
+{
+	uint64_t factors[FACTORS_MAX];
+	struct timespec start, end;
+	size_t i, j, n;
+
+	*sum = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++)
+		for (j = 0, n = fn(numbers[i], factors); j < n; j++)
+			*sum = *sum * 31 + factors[j];
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start.tv_sec) +
+		(end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+/**
+ * main - Entry point
+ *
+ * @ac: Arguments count
+ * @av: Arguments vector
+ *
+ * Return: EXIT_SUCCESS, or EXIT_FAILURE if the implementations disagree
+ */
+int main(int ac, char **av)
+{
+	static bench_class_t const classes[NUM_CLASSES] = {
+		{"random 32-bit", 32, 0, 0},
+		{"semiprime 2x24-bit", 24, 1, 0},
+		{"random 64-bit", 64, 0, 1},
+		{"semiprime 2x31-bit", 31, 1, 1}
+	};
+	size_t count = ac > 1 ? strtoul(av[1], NULL, 10) : 20, i, c;
+	int all = ac > 2 && !strcmp(av[2], "-a"), status = EXIT_SUCCESS;
+	uint64_t *numbers = malloc(sizeof(*numbers) * count);
+	uint64_t state = 88172645463325252UL;
+	uint64_t fast_sum, slow_sum, warmup[FACTORS_MAX];
+	double fast, slow;
+
+	if (!numbers || !count)
+		return (EXIT_FAILURE);
+	factor_u64(6, warmup); /* Builds the shared sieve outside of timings */
+	printf("%-20s %14s %14s %9s\n", "class", "rho (us/num)",
+	       "trial (us/num)", "speedup");
+	for (c = 0; c < NUM_CLASSES; c++)
+	{
+		for (i = 0; i < count; i++)
+			numbers[i] = make_number(&classes[c], &state);
+		fast = run(factor_u64, numbers, count, &fast_sum);
+		if (classes[c].slow && !all)
+		{
+			printf("%-20s %14.2f %14s %9s\n", classes[c].name,
+			       fast * 1e6 / count, "-", "-");
+			continue;
+		}
+		slow = run(trial_factor, numbers, count, &slow_sum);
+		printf("%-20s %14.2f %14.2f %8.1fx\n", classes[c].name,
+		       fast * 1e6 / count, slow * 1e6 / count, slow / fast);
+		if (fast_sum != slow_sum)
+		{
+			fprintf(stderr, "%s: results differ\n",
+				classes[c].name);
+			status = EXIT_FAILURE;
+		}
+	}
+	free(numbers);
+	return (status);
+}
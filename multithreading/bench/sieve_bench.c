@@ -0,0 +1,174 @@
+#include "../sieve.h"
+#include "../topology.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Throughput of the wheel-30 segmented range sieve, counting and
+ * enumerating the primes of [lo, lo + length).
+ *
+ * make bench_sieve (or see the Makefile for the sources)
+ * ./sieve_bench [lo] [length]
+ * ./sieve_bench check [length]
+ *
+ * Both run on the parallel_for pool, one thread per physical core. The
+ * check mode sieves the last numbers below SIEVE_RANGE_MAX, which needs
+ * every prime below 2^32, and compares the primes found with a
+ * Miller-Rabin test of each odd number.
+ */
+
+#define CHECK_LENGTH 1000000
+
+__extension__ typedef unsigned __int128 u128_t;
+
+/**
+ * elapsed - Measures the time since a starting point
+ *
+ * @start: Starting point
+ *
+ * Return: Elapsed time, in seconds
+ */
+static double elapsed(struct timespec const *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start->tv_sec) +
+		(end.tv_nsec - start->tv_nsec) / 1e9);
+}
+
+/**
+ * pow_mod - Modular exponentiation
+ *
+ * @b: Base
+ * @e: Exponent
+ * @m: Modulus
+ *
+ * Return: b^e mod m
+ */
+static uint64_t pow_mod(uint64_t b, uint64_t e, uint64_t m)
+{
+	uint64_t r = 1;
+
+	for (b %= m; e; e >>= 1, b = (u128_t)b * b % m)
+		if (e & 1)
+			r = (u128_t)r * b % m;
+	return (r);
+}
+
+/**
+ * is_prime - Deterministic Miller-Rabin test for 64-bit odd numbers
+ *
+ * @n: Odd number, greater than 37
+ *
+ * Return: 1 if @n is prime, 0 otherwise
+ */
+static int is_prime(uint64_t n)
+{
+	static uint64_t const bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29,
+					 31, 37};
+	uint64_t d = n - 1, x;
+	int s = 0, r;
+	size_t i;
+
+	for (; !(d & 1); d >>= 1)
+		s++;
+	for (i = 0; i < sizeof(bases) / sizeof(*bases); i++)
+	{
+		x = pow_mod(bases[i], d, n);
+		for (r = 1; x != 1 && x != n - 1 && r < s; r++)
+			x = (u128_t)x * x % n;
+		if (x != 1 && x != n - 1)
+			return (0);
+	}
+	return (1);
+}
+
+/**
+ * check - Checks the sieve on the last numbers of its range
+ *
+ * @length: Numbers to check, below SIEVE_RANGE_MAX
+ *
+ * Return: EXIT_SUCCESS, or EXIT_FAILURE on error or mismatch
+ */
+static int check(uint64_t length)
+{
+	uint64_t lo = SIEVE_RANGE_MAX - length, n, p, count, expect = 0;
+	struct timespec start;
+	sieve_iter_t iter;
+	int ret;
+
+	printf("check [%llu, +%llu)\n", (unsigned long long)lo,
+	       (unsigned long long)length);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (sieve_count(lo, SIEVE_RANGE_MAX, &count) ||
+	    sieve_iter_init(&iter, lo, SIEVE_RANGE_MAX))
+		return (EXIT_FAILURE);
+	for (n = lo | 1; n < SIEVE_RANGE_MAX; n += 2)
+	{
+		if (!is_prime(n))
+			continue;
+		expect++;
+		if ((ret = sieve_iter_next(&iter, &p)) != 1 || p != n)
+			break;
+	}
+	if (n >= SIEVE_RANGE_MAX)
+		ret = sieve_iter_next(&iter, &p);
+	sieve_iter_destroy(&iter);
+	if (n < SIEVE_RANGE_MAX || ret != 0 || count != expect)
+	{
+		printf("mismatch at %llu: counted %llu, expected %llu\n",
+		       (unsigned long long)n, (unsigned long long)count,
+		       (unsigned long long)expect);
+		return (EXIT_FAILURE);
+	}
+	printf("%-10s %12llu primes %8.3f s\n", "ok",
+	       (unsigned long long)count, elapsed(&start));
+	return (EXIT_SUCCESS);
+}
+
+/**
+ * main - Entry point
+ *
+ * @ac: Arguments count
+ * @av: Arguments vector
+ *
+ * Return: EXIT_SUCCESS, or EXIT_FAILURE on error
+ */
+int main(int ac, char **av)
+{
+	uint64_t lo = ac > 1 ? strtoull(av[1], NULL, 10) : 1000000000000ULL;
+	uint64_t length = ac > 2 ? strtoull(av[2], NULL, 10) : 1000000000ULL;
+	uint64_t count, listed = 0, sum = 0, p;
+	struct timespec start;
+	sieve_iter_t iter;
+	double t;
+	int ret;
+
+	if (ac > 1 && !strcmp(av[1], "check"))
+		return (check(ac > 2 ? strtoull(av[2], NULL, 10) :
+			      CHECK_LENGTH));
+	printf("[%llu, +%llu) on %d cores\n", (unsigned long long)lo,
+	       (unsigned long long)length, topology_get()->allowed_cores);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (sieve_count(lo, lo + length, &count))
+		return (EXIT_FAILURE);
+	t = elapsed(&start);
+	printf("%-10s %12llu primes %8.3f s %10.2f Mnumbers/s\n", "count",
+	       (unsigned long long)count, t, length / t / 1e6);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (sieve_iter_init(&iter, lo, lo + length))
+		return (EXIT_FAILURE);
+	while ((ret = sieve_iter_next(&iter, &p)) == 1)
+		listed++, sum += p;
+	sieve_iter_destroy(&iter);
+	t = elapsed(&start);
+	if (ret < 0 || listed != count)
+		return (EXIT_FAILURE);
+	printf("%-10s %12llu primes %8.3f s %10.2f Mnumbers/s (sum %llx)\n",
+	       "enumerate", (unsigned long long)listed, t, length / t / 1e6,
+	       (unsigned long long)sum);
+	return (EXIT_SUCCESS);
+}
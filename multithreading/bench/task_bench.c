@@ -0,0 +1,609 @@
+#include "../multithreading.h"
+#include "../clist.h"
+#include "../factor.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+/*
+ * Throughput and latency of the task runtime, against thread counts:
+ *
+ *  empty    create_task and exec_tasks cost of tasks doing nothing
+ *  fanout   latency of a round of tiny tasks spread over the workers and
+ *           joined again, the pattern of the exercise mains
+ *  produce  1..N threads creating tasks into a shared list, under a mutex
+ *           (list_t) and lock-free (clist_t)
+ *  mixed    makespan of a mix of 90% 1 us, 9% 50 us and 1% 2 ms tasks,
+ *           with exec_tasks and with the priority scheduler
+ *  factor   prime_factors over a dataset: one number per line of a file,
+ *           or random 32-bit numbers and 2x31-bit semiprimes
+ *  coro     exec_tasks_coro on tasks blocked in coro_wait_fd on pipes,
+ *           CORO_WAITERS per pipe, until the pipes are written, the tasks
+ *           time out, or they are cancelled with cancel_task; the number
+ *           of tasks that did not succeed follows each makespan
+ *
+ * make bench_tasks (or see the Makefile for the sources)
+ * ./task_bench [-t max_threads] [-n tasks] [-f numbers_file] [bench...]
+ */
+
+#define MAX_THREADS 64
+#define FANOUT_ROUNDS 200
+#define CORO_PIPES 256
+/* Tasks waiting on each pipe of the coro benchmark */
+#define CORO_WAITERS 2
+/* Delay before the pipes of the coro benchmark are written or cancelled */
+#define CORO_DELAY_NS 1000000
+
+/**
+ * struct bench_opts_s - Command line options
+ *
+ * @threads: Largest thread count
+ * @tasks:   Number of tasks per measure
+ * @file:    Dataset of numbers to factor, or NULL
+ */
+typedef struct bench_opts_s
+{
+	int threads;
+	size_t tasks;
+	char const *file;
+} bench_opts_t;
+
+/**
+ * struct producer_s - Producer thread of the produce benchmark
+ *
+ * @count: Tasks to create
+ * @list:  Shared list_t, or NULL to use @clist
+ * @lock:  Mutex of @list
+ * @clist: Shared concurrent list
+ */
+typedef struct producer_s
+{
+	size_t count;
+	list_t *list;
+	pthread_mutex_t *lock;
+	clist_t *clist;
+} producer_t;
+
+/**
+ * struct coro_bench_s - Tasks of the coro benchmark and their pipes
+ *
+ * @tasks: Tasks, each reading one byte from a pipe, CORO_WAITERS per pipe
+ * @fds:   Read and write ends of every pipe
+ * @count: Number of pipes
+ */
+typedef struct coro_bench_s
+{
+	list_t tasks;
+	int fds[CORO_PIPES][2];
+	size_t count;
+} coro_bench_t;
+
+/**
+ * empty_entry - Entry of a task doing nothing
+ *
+ * @arg: Returned as is
+ *
+ * Return: @arg
+ */
+static void *empty_entry(void *arg)
+{
+	return (arg);
+}
+
+/**
+ * spin_entry - Entry of a task busy for a given time
+ *
+ * @arg: Duration, in nanoseconds
+ *
+ * Return: @arg
+ */
+static void *spin_entry(void *arg)
+{
+	uint64_t end = task_clock_ns() + (uintptr_t)arg;
+
+	while (task_clock_ns() < end)
+		;
+	return (arg);
+}
+
+/**
+ * run_workers - Runs a thread entry on a number of threads and joins them
+ *
+ * @entry:   Thread entry
+ * @arg:     Entry argument
+ * @threads: Number of threads
+ */
+static void run_workers(void *(*entry)(void *), void *arg, int threads)
+{
+	pthread_t tids[MAX_THREADS];
+	int t;
+
+	for (t = 0; t < threads; t++)
+		if (pthread_create(&tids[t], NULL, entry, arg))
+			break;
+	while (t--)
+		pthread_join(tids[t], NULL);
+}
+
+/**
+ * make_tasks - Fills a list with tasks
+ *
+ * @list:  List to initialize and fill
+ * @count: Number of tasks
+ * @entry: Entry of every task
+ * @arg:   Parameter of every task
+ */
+static void make_tasks(list_t *list, size_t count, task_entry_t entry,
+		       void *arg)
+{
+	size_t i;
+
+	list_init(list);
+	for (i = 0; i < count; i++)
+		list_add(list, create_task(entry, arg));
+}
+
+/**
+ * bench_empty - Measures create_task and exec_tasks on empty tasks
+ *
+ * @opts:    Options
+ * @threads: Number of workers
+ */
+static void bench_empty(bench_opts_t const *opts, int threads)
+{
+	uint64_t start, created, done;
+	list_t tasks;
+
+	start = task_clock_ns();
+	make_tasks(&tasks, opts->tasks, empty_entry, &tasks);
+	created = task_clock_ns();
+	run_workers((task_entry_t)exec_tasks_quiet, &tasks, threads);
+	done = task_clock_ns();
+	printf("%-8s %3d  create %8.1f ns/task  exec %8.1f ns/task"
+	       "  %6.2f Mtasks/s\n", "empty", threads,
+	       (double)(created - start) / opts->tasks,
+	       (double)(done - created) / opts->tasks,
+	       opts->tasks * 1e3 / (done - created));
+	list_destroy(&tasks, free);
+}
+
+/**
+ * compare_u64 - qsort comparator of uint64_t
+ *
+ * @a: First number
+ * @b: Second number
+ *
+ * Return: Negative, zero or positive
+ */
+static int compare_u64(void const *a, void const *b)
+{
+	uint64_t x = *(uint64_t const *)a, y = *(uint64_t const *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/**
+ * bench_fanout - Measures the latency of rounds of fan-out/fan-in
+ *
+ * @opts:    Options
+ * @threads: Number of workers
+ */
+static void bench_fanout(bench_opts_t const *opts, int threads)
+{
+	uint64_t lat[FANOUT_ROUNDS], start;
+	list_t tasks;
+	int r;
+
+	(void)opts;
+	for (r = 0; r < FANOUT_ROUNDS; r++)
+	{
+		start = task_clock_ns();
+		make_tasks(&tasks, 4 * threads, empty_entry, &tasks);
+		run_workers((task_entry_t)exec_tasks_quiet, &tasks, threads);
+		lat[r] = task_clock_ns() - start;
+		list_destroy(&tasks, free);
+	}
+	qsort(lat, FANOUT_ROUNDS, sizeof(*lat), compare_u64);
+	printf("%-8s %3d  %d tasks/round  p50 %8.1f us  p99 %8.1f us\n",
+	       "fanout", threads, 4 * threads, lat[FANOUT_ROUNDS / 2] / 1e3,
+	       lat[FANOUT_ROUNDS * 99 / 100] / 1e3);
+}
+
+/**
+ * producer_thread - Creates tasks into a shared list
+ *
+ * @arg: Producer
+ *
+ * Return: NULL
+ */
+static void *producer_thread(void *arg)
+{
+	producer_t const *p = arg;
+	task_t *task;
+	size_t i;
+
+	for (i = 0; i < p->count; i++)
+	{
+		task = create_task(empty_entry, arg);
+		if (p->list)
+		{
+			pthread_mutex_lock(p->lock);
+			list_add(p->list, task);
+			pthread_mutex_unlock(p->lock);
+		}
+		else
+			clist_add(p->clist, task);
+	}
+	return (NULL);
+}
+
+/**
+ * bench_produce - Measures task creation by concurrent producers
+ *
+ * @opts:    Options
+ * @threads: Number of producers
+ */
+static void bench_produce(bench_opts_t const *opts, int threads)
+{
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	producer_t p = {0};
+	uint64_t start, locked, lockfree;
+	list_t list;
+	clist_t clist;
+
+	p.count = opts->tasks / threads;
+	p.lock = &lock;
+	p.list = list_init(&list);
+	start = task_clock_ns();
+	run_workers(producer_thread, &p, threads);
+	locked = task_clock_ns() - start;
+	list_destroy(&list, free);
+	p.list = NULL;
+	p.clist = clist_init(&clist);
+	start = task_clock_ns();
+	run_workers(producer_thread, &p, threads);
+	lockfree = task_clock_ns() - start;
+	clist_destroy(&clist, free);
+	printf("%-8s %3d  list_t+mutex %6.2f Mtasks/s"
+	       "  clist_t %6.2f Mtasks/s\n", "produce", threads,
+	       p.count * threads * 1e3 / locked,
+	       p.count * threads * 1e3 / lockfree);
+}
+
+/**
+ * xorshift - Advances a xorshift64 generator
+ *
+ * @state: Generator state, not 0
+ *
+ * Return: New state
+ */
+static uint64_t xorshift(uint64_t *state)
+{
+	*state ^= *state << 13, *state ^= *state >> 7, *state ^= *state << 17;
+	return (*state);
+}
+
+/**
+ * make_mixed - Fills a list with tasks of mixed sizes
+ *
+ * @list:  List to initialize and fill
+ * @count: Number of tasks
+ * @work:  Where to store the total work, in nanoseconds
+ */
+static void make_mixed(list_t *list, size_t count, uint64_t *work)
+{
+	uint64_t state = 88172645463325252ULL, ns;
+	task_t *task;
+	size_t i;
+
+	list_init(list);
+	for (*work = 0, i = 0; i < count; i++)
+	{
+		xorshift(&state);
+		ns = state % 100 == 0 ? 2000000 :
+			state % 100 < 10 ? 50000 : 1000;
+		task = create_task(spin_entry, (void *)(uintptr_t)ns);
+		task->priority = ns > 50000 ? TASK_PRIO_BULK : TASK_PRIO_NORMAL;
+		list_add(list, task);
+		*work += ns;
+	}
+}
+
+/**
+ * bench_mixed - Measures the makespan of mixed task sizes, with exec_tasks
+ *               and with the priority scheduler
+ *
+ * @opts:    Options
+ * @threads: Number of workers
+ */
+static void bench_mixed(bench_opts_t const *opts, int threads)
+{
+	size_t count = opts->tasks / 100 ? opts->tasks / 100 : 1;
+	uint64_t work, start, plain, sched;
+	task_sched_t *s;
+	list_t tasks;
+
+	make_mixed(&tasks, count, &work);
+	start = task_clock_ns();
+	run_workers((task_entry_t)exec_tasks_quiet, &tasks, threads);
+	plain = task_clock_ns() - start;
+	list_destroy(&tasks, free);
+	make_mixed(&tasks, count, &work);
+	start = task_clock_ns();
+	s = sched_create(&tasks);
+	run_workers((task_entry_t)exec_tasks_sched, s, threads);
+	sched = task_clock_ns() - start;
+	sched_destroy(s);
+	list_destroy(&tasks, free);
+	printf("%-8s %3d  %zu tasks  exec_tasks %8.1f ms (%3.0f%%)"
+	       "  sched %8.1f ms (%3.0f%%)\n", "mixed", threads, count,
+	       plain / 1e6, 100.0 * work / threads / plain, sched / 1e6,
+	       100.0 * work / threads / sched);
+}
+
+/**
+ * load_numbers - Loads the factoring dataset
+ *
+ * @opts:  Options
+ * @count: Where to store the number of numbers
+ *
+ * Return: Malloc'd array of malloc'd decimal strings, or NULL
+ */
+static char **load_numbers(bench_opts_t const *opts, size_t *count)
+{
+	uint64_t state = 0x9e3779b97f4a7c15ULL, p, q;
+	size_t n = 0, cap = opts->file ? 1024 : opts->tasks / 10 + 1;
+	char **numbers = malloc(sizeof(*numbers) * cap), line[64], **tmp;
+	FILE *file = opts->file ? fopen(opts->file, "r") : NULL;
+
+	if (!numbers || (opts->file && !file))
+		return (free(numbers), NULL);
+	while (file ? fgets(line, sizeof(line), file) != NULL : n < cap)
+	{
+		if (!file)
+		{
+			xorshift(&state);
+			p = (state >> 33) | 1UL << 30 | 1;
+			q = (state & 0x7fffffff) | 1UL << 30 | 1;
+			while (!is_prime_u64(p))
+				p += 2;
+			while (!is_prime_u64(q))
+				q += 2;
+			sprintf(line, "%lu",
+				(unsigned long)(n & 1 ? p * q : state >> 32));
+		}
+		if (n == cap &&
+		    (tmp = realloc(numbers, sizeof(*numbers) * cap * 2)))
+			numbers = tmp, cap *= 2;
+		if (n == cap || !(numbers[n] = strdup(line)))
+			break;
+		n++;
+	}
+	if (file)
+		fclose(file);
+	*count = n;
+	return (numbers);
+}
+
+/**
+ * bench_factor - Measures prime_factors tasks over a dataset
+ *
+ * @opts:    Options
+ * @threads: Number of workers
+ */
+static void bench_factor(bench_opts_t const *opts, int threads)
+{
+	static char **numbers;
+	static size_t count;
+	uint64_t start, elapsed;
+	list_t tasks;
+	size_t i;
+
+	if (!numbers && !(numbers = load_numbers(opts, &count)))
+	{
+		fprintf(stderr, "factor: cannot load the dataset\n");
+		return;
+	}
+	list_init(&tasks);
+	start = task_clock_ns();
+	for (i = 0; i < count; i++)
+		list_add(&tasks, create_task((task_entry_t)prime_factors,
+					     numbers[i]));
+	run_workers((task_entry_t)exec_tasks_quiet, &tasks, threads);
+	elapsed = task_clock_ns() - start;
+	list_destroy(&tasks, (node_func_t)destroy_task);
+	printf("%-8s %3d  %zu numbers  %8.2f us/number  %8.0f numbers/s\n",
+	       "factor", threads, count, elapsed / 1e3 / count,
+	       count * 1e9 / elapsed);
+}
+
+/**
+ * pipe_entry - Entry of a task reading a byte from a pipe, parking its
+ *              coroutine until the byte arrives
+ *
+ * @arg: Read end of the pipe
+ *
+ * Return: @arg once the byte is read, NULL if the task was cancelled
+ */
+static void *pipe_entry(void *arg)
+{
+	int fd = (int)(intptr_t)arg;
+	char c;
+
+	if (coro_wait_fd(fd, EPOLLIN))
+		return (NULL);
+	return (read(fd, &c, 1) == 1 ? arg : NULL);
+}
+
+/**
+ * feed_thread - Writes a byte per waiting task to every pipe of the coro
+ *               benchmark, last pipe first, after CORO_DELAY_NS
+ *
+ * @arg: Benchmark state
+ *
+ * Return: NULL
+ */
+static void *feed_thread(void *arg)
+{
+	coro_bench_t *bench = arg;
+	char bytes[CORO_WAITERS] = {0};
+	size_t i;
+
+	usleep(CORO_DELAY_NS / 1000);
+	for (i = bench->count; i--;)
+		if (write(bench->fds[i][1], bytes, sizeof(bytes)) !=
+		    (ssize_t)sizeof(bytes))
+			break;
+	return (NULL);
+}
+
+/**
+ * cancel_thread - Cancels every task of the coro benchmark after
+ *                 CORO_DELAY_NS
+ *
+ * @arg: Benchmark state
+ *
+ * Return: NULL
+ */
+static void *cancel_thread(void *arg)
+{
+	coro_bench_t *bench = arg;
+	node_t *node;
+
+	usleep(CORO_DELAY_NS / 1000);
+	for (node = bench->tasks.head; node; node = node->next)
+		cancel_task(node->content);
+	return (NULL);
+}
+
+/**
+ * coro_round - Runs the tasks of the coro benchmark once, on fresh pipes
+ *
+ * @bench:     Benchmark state
+ * @threads:   Number of workers
+ * @helper:    Thread writing the pipes or cancelling the tasks, or NULL
+ * @timeout:   Timeout of every task, or 0
+ * @missed:    Where to store the number of tasks that did not succeed
+ *
+ * Return: Makespan, in nanoseconds, or 0 if the pipes cannot be made
+ */
+static uint64_t coro_round(coro_bench_t *bench, int threads,
+			   void *(*helper)(void *), uint64_t timeout,
+			   size_t *missed)
+{
+	uint64_t start, elapsed;
+	pthread_t tid;
+	task_t *task;
+	node_t *node;
+	size_t i, w;
+
+	list_init(&bench->tasks);
+	for (bench->count = 0; bench->count < CORO_PIPES; bench->count++)
+	{
+		if (pipe(bench->fds[bench->count]))
+			break;
+		for (w = 0; w < CORO_WAITERS; w++)
+		{
+			task = create_task(pipe_entry, (void *)(intptr_t)
+					   bench->fds[bench->count][0]);
+			task->timeout_ns = timeout;
+			list_add(&bench->tasks, task);
+		}
+	}
+	start = task_clock_ns();
+	if (bench->count == CORO_PIPES &&
+	    (!helper || !pthread_create(&tid, NULL, helper, bench)))
+	{
+		run_workers((task_entry_t)exec_tasks_coro, &bench->tasks,
+			    threads);
+		if (helper)
+			pthread_join(tid, NULL);
+	}
+	elapsed = task_clock_ns() - start;
+	for (*missed = 0, node = bench->tasks.head; node; node = node->next)
+		*missed += ((task_t *)node->content)->status != SUCCESS;
+	for (i = 0; i < bench->count; i++)
+		close(bench->fds[i][0]), close(bench->fds[i][1]);
+	i = bench->count;
+	list_destroy(&bench->tasks, free);
+	return (i == CORO_PIPES ? elapsed : 0);
+}
+
+/**
+ * bench_coro - Measures exec_tasks_coro on tasks waiting on pipes, resumed
+ *              by the pipes being written, by their timeout, and by
+ *              cancel_task
+ *
+ * @opts:    Options
+ * @threads: Number of workers
+ */
+static void bench_coro(bench_opts_t const *opts, int threads)
+{
+	static coro_bench_t bench;
+	uint64_t ready, timeout, cancel;
+	size_t failed, timed_out, cancelled;
+
+	(void)opts;
+	ready = coro_round(&bench, threads, feed_thread, 0, &failed);
+	timeout = coro_round(&bench, threads, NULL, CORO_DELAY_NS, &timed_out);
+	cancel = coro_round(&bench, threads, cancel_thread, 0, &cancelled);
+	if (!ready || !timeout || !cancel)
+	{
+		fprintf(stderr, "coro: cannot make %d pipes\n", CORO_PIPES);
+		return;
+	}
+	printf("%-8s %3d  %d tasks  ready %6.2f ms (%zu)"
+	       "  timeout %6.2f ms (%zu)  cancel %6.2f ms (%zu)\n", "coro",
+	       threads, CORO_PIPES * CORO_WAITERS, ready / 1e6, failed,
+	       timeout / 1e6, timed_out, cancel / 1e6, cancelled);
+}
+
+/**
+ * main - Entry point
+ *
+ * @ac: Arguments count
+ * @av: Arguments vector
+ *
+ * Return: EXIT_SUCCESS, or EXIT_FAILURE on usage error
+ */
+int main(int ac, char **av)
+{
+	static char const *const names[] = {
+		"empty", "fanout", "produce", "mixed", "factor", "coro"
+	};
+	static void (*const benches[])(bench_opts_t const *, int) = {
+		bench_empty, bench_fanout, bench_produce, bench_mixed,
+		bench_factor, bench_coro
+	};
+	bench_opts_t opts = {0, 100000, NULL};
+	int opt, b, t, selected = 0, all;
+
+	opts.threads = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+	while ((opt = getopt(ac, av, "t:n:f:")) != -1)
+		if (opt == 't')
+			opts.threads = atoi(optarg);
+		else if (opt == 'n')
+			opts.tasks = strtoul(optarg, NULL, 10);
+		else if (opt == 'f')
+			opts.file = optarg;
+		else
+			return (EXIT_FAILURE);
+	opts.threads = opts.threads < 1 ? 1 : opts.threads > MAX_THREADS ?
+		MAX_THREADS : opts.threads;
+	if (!opts.tasks)
+		return (EXIT_FAILURE);
+	all = optind == ac;
+	for (b = 0; b < (int)(sizeof(names) / sizeof(*names)); b++)
+	{
+		for (t = optind; t < ac && strcmp(av[t], names[b]); t++)
+			;
+		if (!all && t == ac)
+			continue;
+		selected++;
+		for (t = 1; t <= opts.threads; t = t * 2 > opts.threads &&
+		     t < opts.threads ? opts.threads : t * 2)
+			benches[b](&opts, t);
+	}
+	return (selected ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,117 @@
+#include "../tlog.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Measures the cost of a tlog call, from several threads at once, then
+ * dumps the records for tlog_decode.
+ *
+ * make bench_tlog tlog_decode
+ * ./tlog_bench [threads] [records per thread] [dump file]
+ * ./tlog_decode tlog.bin
+ *
+ * Records beyond the ring size between two dumps are dropped, so each
+ * thread logs in batches of TLOG_RING_SIZE / 2 and the main thread dumps
+ * between batches.
+ */
+
+#define MAX_THREADS 64
+
+static pthread_barrier_t batch_start, batch_end;
+static size_t batches;
+
+/**
+ * elapsed - Measures the time since a starting point
+ *
+ * @start: Starting point
+ *
+ * Return: Elapsed time, in nanoseconds
+ */
+static double elapsed(struct timespec const *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start->tv_sec) * 1e9 +
+		(end.tv_nsec - start->tv_nsec));
+}
+
+/**
+ * logger - Logs batches of records, a mix of integers, doubles and strings
+ *
+ * @arg: Thread number, as an intptr_t
+ *
+ * Return: Number of rejected or dropped records, as an intptr_t
+ */
+static void *logger(void *arg)
+{
+	int id = (int)(intptr_t)arg;
+	intptr_t failed = 0;
+	unsigned long n;
+	size_t b, i;
+
+	for (b = 0; b < batches; b++)
+	{
+		pthread_barrier_wait(&batch_start);
+		for (i = 0; i < TLOG_RING_SIZE / 2; i += 2)
+		{
+			n = b * TLOG_RING_SIZE / 2 + i;
+			failed += !!tlog("thread %d record %lu\n", id, n);
+			failed += !!tlog("value %f of %s\n", i * 0.5, "bench");
+		}
+		pthread_barrier_wait(&batch_end);
+	}
+	return ((void *)failed);
+}
+
+/**
+ * main - Entry point
+ *
+ * @ac: Arguments count
+ * @av: Arguments vector
+ *
+ * Return: EXIT_SUCCESS, or EXIT_FAILURE on error
+ */
+int main(int ac, char **av)
+{
+	long threads = ac > 1 ? strtol(av[1], NULL, 10) : 4;
+	size_t count = ac > 2 ? strtoul(av[2], NULL, 10) : 1000000;
+	char const *path = ac > 3 ? av[3] : "tlog.bin";
+	pthread_t tids[MAX_THREADS];
+	struct timespec start;
+	double ns = 0;
+	long t, failed = 0;
+	void *ret;
+	size_t b;
+
+	if (threads < 1 || threads > MAX_THREADS)
+		return (EXIT_FAILURE);
+	batches = (count + TLOG_RING_SIZE / 2 - 1) / (TLOG_RING_SIZE / 2);
+	remove(path);
+	pthread_barrier_init(&batch_start, NULL, threads + 1);
+	pthread_barrier_init(&batch_end, NULL, threads + 1);
+	for (t = 0; t < threads; t++)
+		pthread_create(&tids[t], NULL, logger, (void *)(intptr_t)t);
+	for (b = 0; b < batches; b++)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		pthread_barrier_wait(&batch_start);
+		pthread_barrier_wait(&batch_end);
+		ns += elapsed(&start);
+		if (tlog_dump(path) < 0)
+			return (EXIT_FAILURE);
+	}
+	for (t = 0; t < threads; t++)
+	{
+		pthread_join(tids[t], &ret);
+		failed += (intptr_t)ret;
+	}
+	printf("%ld threads, %lu records each: %.1f ns per record, %.2f"
+	       " Mrecords/s, %ld rejected or dropped\n", threads,
+	       (unsigned long)(batches * TLOG_RING_SIZE / 2),
+	       ns / (batches * TLOG_RING_SIZE / 2 * threads),
+	       batches * TLOG_RING_SIZE / 2 * threads / ns * 1e3, failed);
+	return (failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
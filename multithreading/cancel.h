@@ -0,0 +1,28 @@
+#ifndef CANCEL_H
+#define CANCEL_H
+
+#include <stdatomic.h>
+
+/* Cancellation token: nonzero once cancellation has been requested */
+typedef atomic_int cancel_token_t;
+
+/*
+ * Token of the task running on the calling thread, set by the task runtime.
+ * Weak, so that code polling it links without the runtime.
+ */
+__attribute__((weak)) __thread cancel_token_t *cancel_current;
+
+/**
+ * cancel_requested - Tells whether the task running on the calling thread
+ *                    has been asked to stop; cheap enough for inner loops
+ *
+ * Return: 1 if it has, 0 otherwise or outside of a task
+ */
+static inline int cancel_requested(void)
+{
+	cancel_token_t *token = cancel_current;
+
+	return (token && atomic_load_explicit(token, memory_order_relaxed));
+}
+
+#endif /* CANCEL_H */
@@ -0,0 +1,169 @@
+#include <sched.h>
+#include <stdlib.h>
+#include "clist.h"
+
+/*
+ * node_t links are plain pointers shared with list.h; they are published
+ * and read with the __atomic builtins, which accept non-atomic objects.
+ */
+#define LINK_LOAD(node) __atomic_load_n(&(node)->next, __ATOMIC_ACQUIRE)
+#define LINK_STORE(node, to) \
+	__atomic_store_n(&(node)->next, to, __ATOMIC_RELEASE)
+
+/**
+ * clist_init - Initializes a concurrent list
+ *
+ * @list: Pointer to the list to initialize
+ *
+ * Return: A pointer to the list
+ */
+clist_t *clist_init(clist_t *list)
+{
+	list->stub.content = NULL;
+	list->stub.prev = NULL;
+	list->stub.next = NULL;
+	atomic_init(&list->tail, &list->stub);
+	atomic_init(&list->size, 0);
+	return (list);
+}
+
+/**
+ * clist_add - Appends a content to a concurrent list; thread-safe and,
+ *             apart from the node allocation, wait-free: producers only
+ *             exchange the tail, then link the previous tail to their node
+ *
+ * @list:    Pointer to the list
+ * @content: Address of the custom content to store in the node
+ *
+ * Return: A pointer to the created node, or NULL
+ */
+node_t *clist_add(clist_t *list, void *content)
+{
+	node_t *node = malloc(sizeof(*node)), *prev;
+
+	if (!node)
+		return (NULL);
+	node->content = content;
+	node->next = NULL;
+	atomic_fetch_add_explicit(&list->size, 1, memory_order_relaxed);
+	prev = atomic_exchange_explicit(&list->tail, node,
+				       memory_order_acq_rel);
+	/* prev is only read by the consumer, through next */
+	node->prev = prev == &list->stub ? NULL : prev;
+	LINK_STORE(prev, node);
+	return (node);
+}
+
+/**
+ * clist_first - Gets the front node of a concurrent list
+ *
+ * @list: Pointer to the list
+ *
+ * Return: Front node, or NULL if no node is linked yet
+ */
+node_t *clist_first(clist_t const *list)
+{
+	return (LINK_LOAD(&list->stub));
+}
+
+/**
+ * clist_next - Gets the node following a node of a concurrent list. A node
+ *              whose producer is still linking it reads as the end of the
+ *              list, and shows up on a later pass.
+ *
+ * @node: Node
+ *
+ * Return: Next node, or NULL
+ */
+node_t *clist_next(node_t const *node)
+{
+	return (LINK_LOAD(node));
+}
+
+/**
+ * clist_each - Iterates over the nodes linked so far and calls a function
+ *              for each; may run while producers append
+ *
+ * @list: Pointer to the list
+ * @func: Pointer to a function to call with the content of each node
+ */
+void clist_each(clist_t const *list, node_func_t func)
+{
+	node_t const *node;
+
+	for (node = clist_first(list); node; node = clist_next(node))
+		func(node->content);
+}
+
+/**
+ * link_wait - Waits until a producer links the node following another one
+ *
+ * @node: Node known not to be the tail
+ *
+ * Return: Next node
+ */
+static node_t *link_wait(node_t const *node)
+{
+	node_t *next;
+
+	while (!(next = LINK_LOAD(node)))
+		sched_yield();
+	return (next);
+}
+
+/**
+ * clist_drain - Moves every content of a concurrent list to the back of a
+ *               list_t and frees the drained nodes; may run while producers
+ *               append, which then start a new chain after the stub
+ *
+ * @list: Pointer to the list
+ * @out:  List receiving the contents, in append order
+ *
+ * Return: Number of contents moved
+ */
+size_t clist_drain(clist_t *list, list_t *out)
+{
+	node_t *node, *next, *last;
+	size_t n = 0;
+
+	if (atomic_load_explicit(&list->tail, memory_order_acquire) ==
+	    &list->stub)
+		return (0);
+	/* The stub must be unlinked before producers can link to it again */
+	node = link_wait(&list->stub);
+	LINK_STORE(&list->stub, NULL);
+	last = atomic_exchange_explicit(&list->tail, &list->stub,
+					memory_order_acq_rel);
+	for (;; node = next)
+	{
+		list_add(out, node->content);
+		n++;
+		next = node == last ? NULL : link_wait(node);
+		free(node);
+		if (!next)
+			break;
+	}
+	atomic_fetch_sub_explicit(&list->size, n, memory_order_relaxed);
+	return (n);
+}
+
+/**
+ * clist_destroy - Destroys the content of a concurrent list; no producer
+ *                 may be appending
+ *
+ * @list:      Pointer to the list
+ * @free_func: Pointer to a function to use to free the content of a node
+ */
+void clist_destroy(clist_t *list, node_func_t free_func)
+{
+	node_t *node, *next;
+
+	for (node = list->stub.next; node; node = next)
+	{
+		if (free_func)
+			free_func(node->content);
+		next = node->next;
+		free(node);
+	}
+	clist_init(list);
+}
@@ -0,0 +1,33 @@
+#ifndef CLIST_H
+#define CLIST_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include "list.h"
+
+/**
+ * struct clist_s - Concurrent append-only list of node_t. Any number of
+ *                  threads may append at once without blocking each other;
+ *                  one consumer at a time may iterate or drain it.
+ *
+ * @stub: Placeholder front node; the first content is stub.next
+ * @tail: Back node, exchanged by producers
+ * @size: Number of contents appended and not drained
+ */
+typedef struct clist_s
+{
+	node_t			stub;
+	node_t *_Atomic		tail;
+	atomic_size_t		size;
+} clist_t;
+
+/* clist.c */
+clist_t	*clist_init(clist_t *list);
+node_t	*clist_add(clist_t *list, void *content);
+node_t	*clist_first(clist_t const *list);
+node_t	*clist_next(node_t const *node);
+void	clist_each(clist_t const *list, node_func_t func);
+size_t	clist_drain(clist_t *list, list_t *out);
+void	clist_destroy(clist_t *list, node_func_t free_func);
+
+#endif /* CLIST_H */
@@ -0,0 +1,154 @@
+#ifndef FACTOR_H
+#define FACTOR_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+#include <stdatomic.h> /* atomic_uint */
+#include "list.h"
+
+/* A 64-bit number has at most 63 prime factors (2^63) */
+#define FACTORS_MAX 64
+/* Trial division bound before switching to Miller-Rabin / Pollard rho */
+#define FACTOR_TRIAL_LIMIT 1024
+/* Numbers factored by one chunk of prime_factors_batch */
+#define BATCH_CHUNK 256
+/* Factorisation cache: shards and entries per shard (a power of 2) */
+#define FCACHE_SHARDS 64
+#define FCACHE_SHARD_CAP 1024
+/* Number of rho steps accumulated into one product before taking a gcd */
+#define RHO_BATCH 128
+/* Factor count returned when the running task is cancelled mid-way */
+#define FACTORS_CANCELLED ((size_t)-1)
+
+__extension__ typedef unsigned __int128 u128_t;
+
+/**
+ * struct mont_s - Montgomery arithmetic context for an odd modulus
+ *
+ * @n:    Odd modulus
+ * @ninv: Inverse of n modulo 2^64
+ * @r1:   2^64 mod n, i.e. 1 in Montgomery form
+ * @r2:   2^128 mod n, used to convert numbers into Montgomery form
+ */
+typedef struct mont_s
+{
+	uint64_t n;
+	uint64_t ninv;
+	uint64_t r1;
+	uint64_t r2;
+} mont_t;
+
+/**
+ * mont_mul - Multiplies two numbers in Montgomery form
+ *
+ * @m: Montgomery context
+ * @a: First operand, lower than m->n
+ * @b: Second operand, lower than m->n
+ *
+ * Return: a * b * 2^-64 mod m->n
+ */
+static inline uint64_t mont_mul(mont_t const *m, uint64_t a, uint64_t b)
+{
+	u128_t t = (u128_t)a * b;
+	uint64_t hi = (uint64_t)(t >> 64);
+	uint64_t q = (uint64_t)t * m->ninv;
+	uint64_t qn = (uint64_t)(((u128_t)q * m->n) >> 64);
+
+	return (hi >= qn ? hi - qn : hi - qn + m->n);
+}
+
+/**
+ * struct divisor_s - Precomputed reciprocal of an odd divisor, so that
+ *                    divisibility and exact division need no division
+ *
+ * @p:   Odd divisor
+ * @inv: Inverse of p modulo 2^64; n * inv is n / p when p divides n
+ * @lim: UINT64_MAX / p; p divides n if and only if n * inv <= lim
+ */
+typedef struct divisor_s
+{
+	uint64_t p;
+	uint64_t inv;
+	uint64_t lim;
+} divisor_t;
+
+/**
+ * struct factor_batch_s - Prime factors of an array of numbers, stored
+ *                         contiguously
+ *
+ * @count:   Number of numbers factored
+ * @offsets: count + 1 offsets into factors; the factors of the i-th number
+ *           are factors[offsets[i]] to factors[offsets[i + 1] - 1]
+ * @factors: Factors of every number, in ascending order for each number
+ */
+typedef struct factor_batch_s
+{
+	size_t count;
+	size_t *offsets;
+	uint64_t *factors;
+} factor_batch_t;
+
+/**
+ * struct factors_s - Prime factors of a number, held in a single allocation
+ *
+ * @n:     Factored number
+ * @refs:  Reference count, for results shared through the factor cache
+ * @count: Number of prime factors, with multiplicity
+ * @f:     Prime factors, in ascending order
+ */
+typedef struct factors_s
+{
+	uint64_t n;
+	atomic_uint refs;
+	size_t count;
+	uint64_t f[];
+} factors_t;
+
+/**
+ * struct factor_cache_stats_s - Counters of the factorisation cache
+ *
+ * @hits:      Lookups served from the cache
+ * @misses:    Lookups that had to factor the number
+ * @evictions: Entries evicted to make room
+ * @entries:   Entries currently cached
+ * @hit_rate:  hits / (hits + misses), 0 before the first lookup
+ */
+typedef struct factor_cache_stats_s
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t entries;
+	double hit_rate;
+} factor_cache_stats_t;
+
+/* factor_montgomery.c */
+void		mont_init(mont_t *m, uint64_t n);
+uint64_t	mont_to(mont_t const *m, uint64_t a);
+uint64_t	mont_pow(mont_t const *m, uint64_t base, uint64_t exp);
+int		is_prime_u64(uint64_t n);
+
+/* factor_rho.c */
+uint64_t	pollard_brent(uint64_t n);
+size_t		factor_large(uint64_t n, uint64_t *factors);
+size_t		factor_u64(uint64_t n, uint64_t *factors);
+
+/* factors_compact.c */
+factors_t	*factors_create(uint64_t n);
+factors_t	*prime_factors_compact(char const *s);
+list_t		*factors_as_list(factors_t const *factors);
+void		factors_list_destroy(list_t *list);
+void		factors_release(void *factors);
+uint64_t const	*factor_batch_get(factor_batch_t const *batch, size_t i,
+				  size_t *count);
+
+/* factor_cache.c */
+factors_t const	*factor_cache_get(uint64_t n);
+factors_t const	*prime_factors_cached(char const *s);
+void		factor_cache_stats(factor_cache_stats_t *stats);
+
+/* prime_factors_batch.c */
+factor_batch_t	*prime_factors_batch(uint64_t const *numbers, size_t count);
+void		factor_batch_destroy(factor_batch_t *batch);
+
+#endif /* FACTOR_H */
@@ -0,0 +1,282 @@
+#include "factor.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+#define FCACHE_INDEX_SIZE (2 * FCACHE_SHARD_CAP)
+#define FCACHE_INDEX_MASK (FCACHE_INDEX_SIZE - 1)
+
+/**
+ * struct fcache_entry_s - Cached factorisation
+ *
+ * @key:        Factored number
+ * @value:      Factors, holding one reference owned by the cache
+ * @referenced: CLOCK bit, set on every hit and cleared by the eviction hand
+ */
+typedef struct fcache_entry_s
+{
+	uint64_t key;
+	factors_t *value;
+	uint8_t referenced;
+} fcache_entry_t;
+
+/**
+ * struct fcache_shard_s - Independently locked part of the cache
+ *
+ * @lock:      Shard mutex
+ * @count:     Number of entries in use
+ * @hand:      CLOCK hand, next entry considered for eviction
+ * @hits:      Lookups served by the shard
+ * @misses:    Lookups missed by the shard
+ * @evictions: Entries evicted from the shard
+ * @entries:   Entries, in CLOCK order
+ * @index:     Open-addressing (linear probing) table of entry index + 1,
+ *             0 for an empty slot
+ */
+typedef struct fcache_shard_s
+{
+	pthread_mutex_t lock;
+	size_t count;
+	size_t hand;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	fcache_entry_t entries[FCACHE_SHARD_CAP];
+	uint16_t index[FCACHE_INDEX_SIZE];
+} fcache_shard_t;
+
+static fcache_shard_t shards[FCACHE_SHARDS];
+static pthread_once_t fcache_once = PTHREAD_ONCE_INIT;
+
+/**
+ * fcache_init - Initializes the shard mutexes, once
+ */
+static void fcache_init(void)
+{
+	size_t i;
+
+	for (i = 0; i < FCACHE_SHARDS; i++)
+		pthread_mutex_init(&shards[i].lock, NULL);
+}
+
+/**
+ * hash_u64 - Mixes the bits of a number (splitmix64 finalizer)
+ *
+ * @x: Number to hash
+ *
+ * Return: Hash of @x
+ */
+static uint64_t hash_u64(uint64_t x)
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return (x ^ (x >> 31));
+}
+
+/**
+ * index_probe - Finds the index slot of a key in a shard
+ *
+ * @shard: Shard
+ * @key:   Key to look for
+ *
+ * Return: Slot holding @key, or the empty slot where it would be inserted
+ */
+static size_t index_probe(fcache_shard_t const *shard, uint64_t key)
+{
+	size_t pos = hash_u64(key) & FCACHE_INDEX_MASK;
+
+	while (shard->index[pos] &&
+	       shard->entries[shard->index[pos] - 1].key != key)
+		pos = (pos + 1) & FCACHE_INDEX_MASK;
+	return (pos);
+}
+
+/**
+ * index_remove - Empties an index slot, shifting back the following slots
+ *                of the probe run so that lookups never need tombstones
+ *
+ * @shard: Shard
+ * @pos:   Slot to empty
+ */
+static void index_remove(fcache_shard_t *shard, size_t pos)
+{
+	size_t next = pos, home;
+
+	for (;;)
+	{
+		next = (next + 1) & FCACHE_INDEX_MASK;
+		if (!shard->index[next])
+			break;
+		home = hash_u64(shard->entries[shard->index[next] - 1].key) &
+			FCACHE_INDEX_MASK;
+		/* Move the slot back unless its home lies in (pos, next] */
+		if (((next - home) & FCACHE_INDEX_MASK) >=
+		    ((next - pos) & FCACHE_INDEX_MASK))
+		{
+			shard->index[pos] = shard->index[next];
+			pos = next;
+		}
+	}
+	shard->index[pos] = 0;
+}
+
+/**
+ * shard_evict - Frees an entry of a full shard with the CLOCK policy:
+ *               recently used entries get a second chance
+ *
+ * @shard: Locked, full shard
+ *
+ * Return: Evicted entry, to be reused
+ */
+static fcache_entry_t *shard_evict(fcache_shard_t *shard)
+{
+	fcache_entry_t *entry;
+
+	for (;;)
+	{
+		entry = &shard->entries[shard->hand];
+		shard->hand = (shard->hand + 1) % FCACHE_SHARD_CAP;
+		if (!entry->referenced)
+			break;
+		entry->referenced = 0;
+	}
+	index_remove(shard, index_probe(shard, entry->key));
+	factors_release(entry->value);
+	shard->evictions++;
+	return (entry);
+}
+
+/**
+ * shard_insert - Caches a value in a shard, evicting an entry when the
+ *                shard is full
+ *
+ * @shard: Locked shard
+ * @key:   Key, not present in the shard
+ * @value: Value; the cache takes a new reference to it
+ */
+static void shard_insert(fcache_shard_t *shard, uint64_t key, factors_t *value)
+{
+	fcache_entry_t *entry;
+
+	if (shard->count < FCACHE_SHARD_CAP)
+		entry = &shard->entries[shard->count++];
+	else
+		entry = shard_evict(shard);
+	entry->key = key;
+	entry->value = value;
+	entry->referenced = 1;
+	atomic_fetch_add(&value->refs, 1);
+	shard->index[index_probe(shard, key)] = entry - shard->entries + 1;
+}
+
+/**
+ * shard_lookup - Looks a key up in a shard, marking the entry as recently
+ *                used and taking a reference to its value
+ *
+ * @shard: Locked shard
+ * @key:   Key
+ *
+ * Return: Referenced value, or NULL if the key is not cached
+ */
+static factors_t *shard_lookup(fcache_shard_t *shard, uint64_t key)
+{
+	size_t pos = index_probe(shard, key);
+	fcache_entry_t *entry;
+
+	if (!shard->index[pos])
+		return (NULL);
+	entry = &shard->entries[shard->index[pos] - 1];
+	entry->referenced = 1;
+	atomic_fetch_add(&entry->value->refs, 1);
+	return (entry->value);
+}
+
+/**
+ * factor_cache_get - Factors a number through the shared, bounded
+ *                    factorisation cache
+ *
+ * @n: Number to factor
+ *
+ * Return: Shared, immutable factors of @n, to be released with
+ * factors_release, or NULL on allocation failure or if the running task is
+ * cancelled; nothing is cached then
+ */
+factors_t const *factor_cache_get(uint64_t n)
+{
+	fcache_shard_t *shard = &shards[(hash_u64(n) >> 32) % FCACHE_SHARDS];
+	factors_t *cached, *fresh;
+
+	pthread_once(&fcache_once, fcache_init);
+	pthread_mutex_lock(&shard->lock);
+	cached = shard_lookup(shard, n);
+	shard->hits += cached != NULL;
+	shard->misses += cached == NULL;
+	pthread_mutex_unlock(&shard->lock);
+	if (cached)
+		return (cached);
+
+	/* Factor outside of the lock; another thread may race us */
+	fresh = factors_create(n);
+	if (!fresh)
+		return (NULL);
+	pthread_mutex_lock(&shard->lock);
+	cached = shard_lookup(shard, n);
+	if (!cached)
+		shard_insert(shard, n, fresh);
+	pthread_mutex_unlock(&shard->lock);
+	if (!cached)
+		return (fresh);
+	factors_release(fresh);
+	return (cached);
+}
+
+/**
+ * prime_factors_cached - Task entry factoring a number given as a string
+ *                        through the factorisation cache. Tasks running it
+ *                        should set their free_result to factors_release
+ *
+ * @s: String representation of the number to factor
+ *
+ * Return: Shared factors of the number, or NULL
+ */
+factors_t const *prime_factors_cached(char const *s)
+{
+	return (factor_cache_get(strtoul(s, NULL, 10)));
+}
+
+/**
+ * factor_cache_stats - Reports the counters of the factorisation cache
+ *
+ * @stats: Where to store the counters
+ */
+void factor_cache_stats(factor_cache_stats_t *stats)
+{
+	fcache_shard_t *shard;
+	size_t i;
+
+	pthread_once(&fcache_once, fcache_init);
+	stats->hits = stats->misses = stats->evictions = stats->entries = 0;
+	for (i = 0; i < FCACHE_SHARDS; i++)
+	{
+		shard = &shards[i];
+		pthread_mutex_lock(&shard->lock);
+		stats->hits += shard->hits;
+		stats->misses += shard->misses;
+		stats->evictions += shard->evictions;
+		stats->entries += shard->count;
+		pthread_mutex_unlock(&shard->lock);
+	}
+	stats->hit_rate = stats->hits + stats->misses ?
+		(double)stats->hits / (stats->hits + stats->misses) : 0;
+}
+
+/**
+ * factor_cache_cleanup - Drops the references held by the cache at exit
+ */
+__attribute__((destructor)) static void factor_cache_cleanup(void)
+{
+	size_t i, j;
+
+	for (i = 0; i < FCACHE_SHARDS; i++)
+		for (j = 0; j < shards[i].count; j++)
+			factors_release(shards[i].entries[j].value);
+}
@@ -0,0 +1,122 @@
+#include "factor.h"
+
+/**
+ * mont_init - Initializes a Montgomery context for an odd modulus
+ *
+ * @m: Pointer to the context to initialize
+ * @n: Odd modulus
+ */
+void mont_init(mont_t *m, uint64_t n)
+{
+	uint64_t inv = n;
+	int i;
+
+	/* Newton iteration, each step doubles the number of correct bits */
+	for (i = 0; i < 5; i++)
+		inv *= 2 - n * inv;
+	m->n = n;
+	m->ninv = inv;
+	m->r1 = (uint64_t)(-n) % n;
+	m->r2 = (uint64_t)(((u128_t)m->r1 * m->r1) % n);
+}
+
+/**
+ * mont_to - Converts a number into Montgomery form
+ *
+ * @m: Montgomery context
+ * @a: Number to convert
+ *
+ * Return: a * 2^64 mod m->n
+ */
+uint64_t mont_to(mont_t const *m, uint64_t a)
+{
+	return (mont_mul(m, a % m->n, m->r2));
+}
+
+/**
+ * mont_pow - Modular exponentiation in Montgomery form
+ *
+ * @m:    Montgomery context
+ * @base: Base, in Montgomery form
+ * @exp:  Exponent
+ *
+ * Return: base^exp, in Montgomery form
+ */
+uint64_t mont_pow(mont_t const *m, uint64_t base, uint64_t exp)
+{
+	uint64_t result = m->r1;
+
+	for (; exp; exp >>= 1)
+	{
+		if (exp & 1)
+			result = mont_mul(m, result, base);
+		base = mont_mul(m, base, base);
+	}
+	return (result);
+}
+
+/**
+ * is_witness - Runs one Miller-Rabin round
+ *
+ * @m: Montgomery context for the tested number
+ * @a: Base to test, lower than m->n
+ * @d: Odd part of m->n - 1
+ * @s: Number of trailing zero bits of m->n - 1
+ *
+ * Return: 1 if @a proves m->n composite, 0 otherwise
+ */
+static int is_witness(mont_t const *m, uint64_t a, uint64_t d, int s)
+{
+	uint64_t one = m->r1, minus_one = m->n - m->r1, x;
+
+	x = mont_pow(m, mont_to(m, a), d);
+	if (x == one || x == minus_one)
+		return (0);
+	while (--s > 0)
+	{
+		x = mont_mul(m, x, x);
+		if (x == minus_one)
+			return (0);
+	}
+	return (1);
+}
+
+/**
+ * is_prime_u64 - Deterministic Miller-Rabin primality test for 64-bit numbers
+ *
+ * @n: Number to test
+ *
+ * Return: 1 if @n is prime, 0 otherwise
+ */
+int is_prime_u64(uint64_t n)
+{
+	static uint64_t const small[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29,
+					 31, 37};
+	/* Jim Sinclair's bases, sufficient for every n < 2^64 */
+	static uint64_t const bases[] = {
+		2, 325, 9375, 28178, 450775, 9780504, 1795265022
+	};
+	uint64_t d, a;
+	size_t i;
+	mont_t m;
+	int s;
+
+	if (n < 2)
+		return (0);
+	for (i = 0; i < sizeof(small) / sizeof(*small); i++)
+		if (n % small[i] == 0)
+			return (n == small[i]);
+	if (n < 37 * 37)
+		return (1);
+
+	mont_init(&m, n);
+	s = __builtin_ctzll(n - 1);
+	d = (n - 1) >> s;
+	for (i = 0; i < sizeof(bases) / sizeof(*bases); i++)
+	{
+		a = bases[i] % n;
+		if (a && is_witness(&m, a, d, s))
+			return (0);
+	}
+	return (1);
+}
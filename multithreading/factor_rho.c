@@ -0,0 +1,220 @@
+#include "factor.h"
+#include "cancel.h"
+#include "sieve.h"
+
+#define ABS_DIFF(a, b) ((a) > (b) ? (a) - (b) : (b) - (a))
+
+/**
+ * gcd_u64 - Binary greatest common divisor
+ *
+ * @a: First number
+ * @b: Second number
+ *
+ * Return: gcd(a, b)
+ */
+static uint64_t gcd_u64(uint64_t a, uint64_t b)
+{
+	int shift;
+
+	if (!a || !b)
+		return (a | b);
+	shift = __builtin_ctzll(a | b);
+	a >>= __builtin_ctzll(a);
+	do {
+		b >>= __builtin_ctzll(b);
+		if (a > b)
+		{
+			uint64_t t = a;
+
+			a = b;
+			b = t;
+		}
+		b -= a;
+	} while (b);
+	return (a << shift);
+}
+
+/**
+ * rho_step - Computes the next rho iterate y^2 + c, in Montgomery form
+ *
+ * @m: Montgomery context
+ * @y: Current iterate
+ * @c: Polynomial constant
+ *
+ * Return: Next iterate
+ */
+static inline uint64_t rho_step(mont_t const *m, uint64_t y, uint64_t c)
+{
+	uint64_t s = mont_mul(m, y, y), t = s + c;
+
+	return ((t < s || t >= m->n) ? t - m->n : t);
+}
+
+/**
+ * rho_attempt - Runs Brent's variant of Pollard rho with a given constant
+ *
+ * @m: Montgomery context for the number to split
+ * @c: Polynomial constant, in Montgomery form
+ *
+ * Return: A divisor of m->n, possibly m->n itself on failure or when the
+ * running task is cancelled
+ */
+static uint64_t rho_attempt(mont_t const *m, uint64_t c)
+{
+	uint64_t x, y = c, ys = c, q = m->r1, g = 1, r = 1, k, i, lim;
+
+	do {
+		x = y;
+		for (i = 0; i < r; i++)
+			y = rho_step(m, y, c);
+		for (k = 0; k < r && g == 1; k += RHO_BATCH)
+		{
+			ys = y;
+			lim = r - k < RHO_BATCH ? r - k : RHO_BATCH;
+			for (i = 0; i < lim; i++)
+			{
+				y = rho_step(m, y, c);
+				q = mont_mul(m, q, ABS_DIFF(x, y));
+			}
+			g = gcd_u64(q, m->n);
+		}
+		if (g == 1 && cancel_requested())
+			return (m->n);
+		r <<= 1;
+	} while (g == 1);
+
+	/* The batched product hit a multiple of n: replay the last batch */
+	if (g == m->n)
+		do {
+			ys = rho_step(m, ys, c);
+			g = gcd_u64(ABS_DIFF(x, ys), m->n);
+		} while (g == 1);
+	return (g);
+}
+
+/**
+ * pollard_brent - Finds a non-trivial divisor of a composite number
+ *
+ * @n: Composite number to split
+ *
+ * Return: A divisor of @n, or @n itself if none could be found or the
+ * running task is cancelled; callers polling cancel_requested must then
+ * discard the factors
+ */
+uint64_t pollard_brent(uint64_t n)
+{
+	uint64_t c, d;
+	mont_t m;
+
+	if (!(n & 1))
+		return (2);
+	mont_init(&m, n);
+	for (c = 1; c < n && !cancel_requested(); c++)
+	{
+		d = rho_attempt(&m, mont_to(&m, c));
+		if (d != 1 && d != n)
+			return (d);
+	}
+	return (n);
+}
+
+/**
+ * factor_trial - Strips the small prime factors of a number, dividing only
+ *                by the primes of the shared sieve
+ *
+ * @n:       Pointer to the number to reduce, updated in place
+ * @factors: Array to store the factors found
+ *
+ * Return: Number of factors stored, in ascending order
+ */
+static size_t factor_trial(uint64_t *n, uint64_t *factors)
+{
+	prime_table_t const *table = sieve_primes(FACTOR_TRIAL_LIMIT + 1);
+	size_t count = 0, i;
+	uint64_t p = 2;
+
+	for (i = 0; i < table->count &&
+	     (p = table->primes[i]) <= FACTOR_TRIAL_LIMIT && p * p <= *n; i++)
+		for (; *n % p == 0; *n /= p)
+			factors[count++] = p;
+	if (*n > 1 && p * p > *n)
+	{
+		factors[count++] = *n;
+		*n = 1;
+	}
+	return (count);
+}
+
+/**
+ * factor_split - Recursively splits a number free of small factors
+ *
+ * @n:       Number to split
+ * @factors: Array to store the factors found
+ * @count:   Number of factors already stored in @factors
+ *
+ * Return: Updated number of factors
+ */
+static size_t factor_split(uint64_t n, uint64_t *factors, size_t count)
+{
+	uint64_t d;
+
+	if (is_prime_u64(n) || (d = pollard_brent(n)) == n)
+	{
+		factors[count++] = n;
+		return (count);
+	}
+	count = factor_split(d, factors, count);
+	return (factor_split(n / d, factors, count));
+}
+
+/**
+ * factor_large - Factors a number that has no prime factor lower than
+ *                FACTOR_TRIAL_LIMIT
+ *
+ * @n:       Number to factor, greater than 1
+ * @factors: Array of at least FACTORS_MAX elements to store the factors
+ *
+ * Return: Number of prime factors, stored in ascending order, or
+ * FACTORS_CANCELLED if the running task is cancelled, as composites may then
+ * be left unsplit
+ */
+size_t factor_large(uint64_t n, uint64_t *factors)
+{
+	size_t count = factor_split(n, factors, 0), i, j;
+	uint64_t tmp;
+
+	if (cancel_requested())
+		return (FACTORS_CANCELLED);
+	for (i = 1; i < count; i++)
+	{
+		tmp = factors[i];
+		for (j = i; j > 0 && factors[j - 1] > tmp; j--)
+			factors[j] = factors[j - 1];
+		factors[j] = tmp;
+	}
+	return (count);
+}
+
+/**
+ * factor_u64 - Factors a 64-bit number into its prime factors
+ *
+ * @n:       Number to factor
+ * @factors: Array of at least FACTORS_MAX elements to store the factors
+ *
+ * Return: Number of prime factors (with multiplicity), stored in ascending
+ * order, or FACTORS_CANCELLED if the running task is cancelled. 0 and 1 have
+ * no factors.
+ */
+size_t factor_u64(uint64_t n, uint64_t *factors)
+{
+	size_t count, large;
+
+	if (n < 2)
+		return (0);
+	count = factor_trial(&n, factors);
+	if (n == 1)
+		return (count);
+	/* Trial factors are already sorted and lower than the remaining ones */
+	large = factor_large(n, factors + count);
+	return (large == FACTORS_CANCELLED ? large : count + large);
+}
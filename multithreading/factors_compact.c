@@ -0,0 +1,113 @@
+#include "factor.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * factors_create - Factors a number into a single allocation
+ *
+ * @n: Number to factor
+ *
+ * Return: Factors of @n, to be released with free or factors_release, or
+ * NULL on allocation failure or if the running task is cancelled
+ */
+factors_t *factors_create(uint64_t n)
+{
+	uint64_t f[FACTORS_MAX];
+	size_t count = factor_u64(n, f);
+	factors_t *factors;
+
+	if (count == FACTORS_CANCELLED)
+		return (NULL);
+	factors = malloc(sizeof(*factors) + sizeof(uint64_t) * count);
+	if (!factors)
+		return (NULL);
+	factors->n = n;
+	atomic_init(&factors->refs, 1);
+	factors->count = count;
+	memcpy(factors->f, f, sizeof(uint64_t) * count);
+	return (factors);
+}
+
+/**
+ * prime_factors_compact - Task entry factoring a number given as a string.
+ *                         Unlike prime_factors, the result costs a single
+ *                         allocation; tasks running it should set their
+ *                         free_result to free
+ *
+ * @s: String representation of the number to factor
+ *
+ * Return: Factors of the number, or NULL
+ */
+factors_t *prime_factors_compact(char const *s)
+{
+	return (factors_create(strtoul(s, NULL, 10)));
+}
+
+/**
+ * factors_release - Drops a reference to shared factors, freeing them with
+ *                   the last reference
+ *
+ * @factors: Factors, as returned by factor_cache_get
+ */
+void factors_release(void *factors)
+{
+	factors_t *f = factors;
+
+	if (f && atomic_fetch_sub_explicit(&f->refs, 1,
+					   memory_order_acq_rel) == 1)
+		free(f);
+}
+
+/**
+ * factors_as_list - Exposes compact factors through a list_t, for code
+ *                   written against prime_factors. The nodes point into
+ *                   @factors, which must outlive the list.
+ *
+ * @factors: Compact factors
+ *
+ * Return: List of pointers to the factors, to be released with
+ * factors_list_destroy, or NULL
+ */
+list_t *factors_as_list(factors_t const *factors)
+{
+	list_t *list = malloc(sizeof(*list));
+	size_t i;
+
+	if (!list || !factors)
+		return (free(list), NULL);
+	list_init(list);
+	for (i = 0; i < factors->count; i++)
+		list_add(list, (void *)&factors->f[i]);
+	return (list);
+}
+
+/**
+ * factors_list_destroy - Frees a list made by factors_as_list, leaving the
+ *                        compact factors untouched
+ *
+ * @list: List to free
+ */
+void factors_list_destroy(list_t *list)
+{
+	if (list)
+	{
+		list_destroy(list, NULL);
+		free(list);
+	}
+}
+
+/**
+ * factor_batch_get - Gets the factors of one number of a batch
+ *
+ * @batch: Batch returned by prime_factors_batch
+ * @i:     Index of the number in the batch
+ * @count: Where to store the number of factors
+ *
+ * Return: Pointer to the first factor, inside the batch arena
+ */
+uint64_t const *factor_batch_get(factor_batch_t const *batch, size_t i,
+				 size_t *count)
+{
+	*count = batch->offsets[i + 1] - batch->offsets[i];
+	return (batch->factors + batch->offsets[i]);
+}
@@ -0,0 +1,98 @@
+#include "multithreading.h"
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define ROUND_UP(n, a) (((n) + (a) - 1) / (a) * (a))
+
+/**
+ * img_map_size - Computes the size of the mapping backing an image
+ * @buf: Image laid out by img_alloc
+ * Return: Size in bytes, a multiple of IMG_HUGEPAGE_SIZE, or 0 on overflow
+ */
+static size_t img_map_size(img_buf_t const *buf)
+{
+	size_t row = buf->stride * sizeof(pixel_t), size, h = buf->img.h;
+
+	if (h && row > (SIZE_MAX - IMG_HUGEPAGE_SIZE) / h)
+		return (0);
+	size = h * row;
+	return (ROUND_UP(size ? size : 1, IMG_HUGEPAGE_SIZE));
+}
+
+/**
+ * map_aligned - Maps anonymous memory aligned on a huge page, so that
+ * transparent huge pages can back all of it
+ * @size: Size of the mapping, a multiple of IMG_HUGEPAGE_SIZE
+ * Return: Mapping, or MAP_FAILED
+ */
+static void *map_aligned(size_t size)
+{
+	uint8_t *map, *start;
+	size_t head;
+
+	map = mmap(NULL, size + IMG_HUGEPAGE_SIZE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		return (MAP_FAILED);
+	start = (uint8_t *)ROUND_UP((uintptr_t)map, IMG_HUGEPAGE_SIZE);
+	head = start - map;
+	if (head)
+		munmap(map, head);
+	if (IMG_HUGEPAGE_SIZE - head)
+		munmap(start + size, IMG_HUGEPAGE_SIZE - head);
+	return (start);
+}
+
+/**
+ * img_alloc - Allocates the pixels of an image, each row starting on a
+ * cache line, in memory that huge pages may back to spare TLB misses when
+ * a blur walks down the columns. The rows being padded, the image is blurred
+ * with blur_image_buf, not blur_image.
+ * @buf: Image to set up
+ * @w: Width
+ * @h: Height
+ * @flags: 0, IMG_HUGEPAGE for transparent huge pages, or IMG_HUGETLB for
+ * reserved ones, falling back to IMG_HUGEPAGE when none is available
+ * Return: 0 on success, -1 on failure; the image is freed with img_free
+ */
+int img_alloc(img_buf_t *buf, size_t w, size_t h, int flags)
+{
+	void *pixels = MAP_FAILED;
+	size_t size;
+
+	if (!buf)
+		return (-1);
+	buf->img.w = w;
+	buf->img.h = h;
+	buf->img.pixels = NULL;
+	/* Pixels are 3 bytes: 64 of them make a whole number of cache lines */
+	buf->stride = ROUND_UP(w ? w : 1, IMG_ROW_ALIGN);
+	size = img_map_size(buf);
+	if (!size)
+		return (-1);
+	if (flags & IMG_HUGETLB)
+		pixels = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (pixels == MAP_FAILED)
+	{
+		pixels = map_aligned(size);
+		if (pixels == MAP_FAILED)
+			return (-1);
+		if (flags & (IMG_HUGEPAGE | IMG_HUGETLB))
+			madvise(pixels, size, MADV_HUGEPAGE);
+	}
+	buf->img.pixels = pixels;
+	return (0);
+}
+
+/**
+ * img_free - Frees the pixels of an image allocated with img_alloc
+ * @buf: Image
+ */
+void img_free(img_buf_t *buf)
+{
+	if (!buf || !buf->img.pixels)
+		return;
+	munmap(buf->img.pixels, img_map_size(buf));
+	buf->img.pixels = NULL;
+}
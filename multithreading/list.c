@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include "list.h"
@@ -20,17 +21,50 @@ node_t *node_create(void *content)
 }
 
 /**
- * list_add - Creates a Node and adds it to the back of a list
+ * list_node_alloc - Takes a node from the slabs of a list, allocating a
+ *                   slab twice as large as the last one when it is full
+ *
+ * @list: Pointer to the list
+ *
+ * Return: A pointer to the node, or NULL
+ */
+static node_t *list_node_alloc(list_t *list)
+{
+	list_slab_t *slab = list->slabs;
+	size_t cap;
+
+	if (!slab || slab->used == slab->cap)
+	{
+		cap = slab ? slab->cap * 2 : LIST_SLAB_MIN;
+		cap = cap > LIST_SLAB_MAX ? LIST_SLAB_MAX : cap;
+		slab = malloc(sizeof(*slab) + sizeof(node_t) * cap);
+		if (!slab)
+			return (NULL);
+		slab->next = list->slabs;
+		slab->cap = cap;
+		slab->used = 0;
+		list->slabs = slab;
+	}
+	return (&slab->nodes[slab->used++]);
+}
+
+/**
+ * list_add - Creates a Node and adds it to the back of a list. The node is
+ *            carved from the list's slabs rather than allocated on its own.
  *
  * @list:    Pointer to the list to add the node to
  * @content: Address of the custom content to store in the node
  *
- * Return: A pointer to the created node
+ * Return: A pointer to the created node, or NULL
  */
 node_t *list_add(list_t *list, void *content)
 {
-	node_t *node = node_create(content);
+	node_t *node = list_node_alloc(list);
 
+	if (!node)
+		return (NULL);
+	node->content = content;
+	node->next = NULL;
 	node->prev = list->tail;
 	if (list->tail)
 		list->tail->next = node;
@@ -53,28 +87,103 @@ list_t *list_init(list_t *list)
 	list->head = NULL;
 	list->tail = NULL;
 	list->size = 0;
+	list->slabs = NULL;
 	return (list);
 }
 
 /**
- * list_destroy - Destroys the content of a list
+ * slab_cmp - qsort comparator ordering slabs by address
+ *
+ * @a: Pointer to the first slab pointer
+ * @b: Pointer to the second slab pointer
+ *
+ * Return: Negative, zero or positive
+ */
+static int slab_cmp(void const *a, void const *b)
+{
+	uintptr_t sa = (uintptr_t)*(list_slab_t * const *)a;
+	uintptr_t sb = (uintptr_t)*(list_slab_t * const *)b;
+
+	return ((sa > sb) - (sa < sb));
+}
+
+/**
+ * node_in_slabs - Tells whether a node was carved from one of a list's
+ *                 slabs
+ *
+ * @list:   Pointer to the list
+ * @sorted: The list's slabs sorted by address, or NULL to scan them
+ * @count:  Number of slabs
+ * @node:   Node
+ *
+ * Return: 1 if it was, 0 if it was made by node_create
+ */
+static int node_in_slabs(list_t const *list, list_slab_t **sorted,
+			 size_t count, node_t const *node)
+{
+	uintptr_t addr = (uintptr_t)node;
+	list_slab_t const *slab = NULL;
+	size_t lo = 0, hi = count, mid;
+
+	if (!sorted)
+	{
+		for (slab = list->slabs; slab; slab = slab->next)
+			if (addr >= (uintptr_t)slab->nodes &&
+			    addr < (uintptr_t)(slab->nodes + slab->cap))
+				return (1);
+		return (0);
+	}
+	/* Last slab starting at or before the node */
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if ((uintptr_t)sorted[mid]->nodes <= addr)
+			slab = sorted[mid], lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (slab && addr < (uintptr_t)(slab->nodes + slab->cap));
+}
+
+/**
+ * list_destroy - Destroys the content of a list. Nodes made by list_add
+ *                are released a slab at a time; nodes linked in by hand
+ *                with node_create are freed one by one.
  *
  * @list:      Pointer to the list structure to destroy the content of
  * @free_func: Pointer to a function to use to free the content of a node
  */
 void list_destroy(list_t *list,  node_func_t free_func)
 {
-	node_t *node;
+	list_slab_t *slab, **sorted = NULL;
+	size_t count = 0;
+	node_t *node, *next;
 
-	for (node = list->head; node;)
+	for (slab = list->slabs; slab; slab = slab->next)
+		count++;
+	if (count > 1)
+		sorted = malloc(sizeof(*sorted) * count);
+	if (sorted)
 	{
-		node_t *tmp = node;
-
+		for (count = 0, slab = list->slabs; slab; slab = slab->next)
+			sorted[count++] = slab;
+		qsort(sorted, count, sizeof(*sorted), slab_cmp);
+	}
+	for (node = list->head; node; node = next)
+	{
+		next = node->next;
 		if (free_func)
 			free_func(node->content);
-		node = node->next;
-		free(tmp);
+		if (!node_in_slabs(list, sorted, count, node))
+			free(node);
+	}
+	free(sorted);
+	while ((slab = list->slabs))
+	{
+		list->slabs = slab->next;
+		free(slab);
 	}
+	list->head = list->tail = NULL;
 	list->size = 0;
 }
 
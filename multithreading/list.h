@@ -17,18 +17,40 @@ typedef struct node_s
 	struct node_s	*next;
 } node_t;
 
+/* Nodes in the first and largest slabs of a list */
+#define LIST_SLAB_MIN 4
+#define LIST_SLAB_MAX 1024
+
+/**
+ * struct list_slab_s - Block of nodes allocated at once for a list
+ *
+ * @next:  Previously allocated slab
+ * @cap:   Number of nodes in the slab
+ * @used:  Number of nodes handed out
+ * @nodes: Nodes
+ */
+typedef struct list_slab_s
+{
+	struct list_slab_s	*next;
+	size_t			cap;
+	size_t			used;
+	node_t			nodes[];
+} list_slab_t;
+
 /**
  * struct list_s - List structure
  *
- * @head: Ponter to the front node
- * @tail: Ponter to the back node
- * @size: Number of nodes in the list
+ * @head:  Ponter to the front node
+ * @tail:  Ponter to the back node
+ * @size:  Number of nodes in the list
+ * @slabs: Slabs the nodes of the list are carved from, newest first
  */
 typedef struct list_s
 {
-	node_t	*head;
-	node_t	*tail;
-	size_t	size;
+	node_t		*head;
+	node_t		*tail;
+	size_t		size;
+	list_slab_t	*slabs;
 } list_t;
 
 typedef void (*node_func_t)(void *);
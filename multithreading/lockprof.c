@@ -0,0 +1,251 @@
+#define LOCKPROF_IMPL
+#include "lockprof.h"
+#include "task_stats.h"
+#include <errno.h>
+#include <stdlib.h>
+
+#define LOAD(x) atomic_load_explicit(&(x), memory_order_relaxed)
+#define ADD(x, n) atomic_fetch_add_explicit(&(x), (n), memory_order_relaxed)
+
+/**
+ * struct lockprof_held_s - Mutex held by the calling thread
+ *
+ * @mutex: Mutex
+ * @site:  Site that acquired it
+ * @since: Start of the hold
+ */
+typedef struct lockprof_held_s
+{
+	pthread_mutex_t *mutex;
+	lockprof_site_t *site;
+	uint64_t since;
+} lockprof_held_t;
+
+static lockprof_site_t *_Atomic sites;
+static __thread lockprof_held_t held[LOCKPROF_DEPTH];
+static __thread int depth;
+
+/**
+ * store_max - Raises a maximum
+ *
+ * @max:   Maximum
+ * @value: Sample
+ */
+static void store_max(atomic_uint_fast64_t *max, uint64_t value)
+{
+	uint_fast64_t old = atomic_load_explicit(max, memory_order_relaxed);
+
+	while (value > old && !atomic_compare_exchange_weak_explicit(max, &old,
+		value, memory_order_relaxed, memory_order_relaxed))
+		;
+}
+
+/**
+ * held_find - Finds a mutex among the ones held by the calling thread
+ *
+ * @mutex: Mutex
+ *
+ * Return: Hold, or NULL if the mutex was not acquired through the profiler
+ */
+static lockprof_held_t *held_find(pthread_mutex_t *mutex)
+{
+	int i;
+
+	for (i = depth - 1; i >= 0; i--)
+		if (held[i].mutex == mutex)
+			return (&held[i]);
+	return (NULL);
+}
+
+/**
+ * hold_end - Accounts for the end of a hold
+ *
+ * @h:   Hold
+ * @now: End of the hold
+ */
+static void hold_end(lockprof_held_t const *h, uint64_t now)
+{
+	ADD(h->site->hold_ns, now - h->since);
+	store_max(&h->site->hold_max, now - h->since);
+}
+
+/**
+ * lockprof_lock - Locks a mutex, accounting the acquisition to its call
+ *                 site; only a contended acquisition measures its wait
+ *
+ * @mutex: Mutex
+ * @site:  Call site
+ *
+ * Return: pthread_mutex_lock result
+ */
+int lockprof_lock(pthread_mutex_t *mutex, lockprof_site_t *site)
+{
+	lockprof_site_t *head;
+	uint64_t start, now;
+	int ret = pthread_mutex_trylock(mutex);
+
+	if (ret == EBUSY)
+	{
+		start = task_clock_ns();
+		ret = pthread_mutex_lock(mutex);
+		now = task_clock_ns();
+		ADD(site->contended, 1);
+		ADD(site->wait_ns, now - start);
+		store_max(&site->wait_max, now - start);
+	}
+	else
+		now = task_clock_ns();
+	if (ret)
+		return (ret);
+	if (!LOAD(site->registered) && !atomic_exchange(&site->registered, 1))
+	{
+		head = atomic_load(&sites);
+		do
+			site->next = head;
+		while (!atomic_compare_exchange_weak(&sites, &head, site));
+	}
+	ADD(site->acquired, 1);
+	if (depth < LOCKPROF_DEPTH)
+	{
+		held[depth].mutex = mutex;
+		held[depth].site = site;
+		held[depth++].since = now;
+	}
+	return (0);
+}
+
+/**
+ * lockprof_unlock - Unlocks a mutex, accounting its hold time
+ *
+ * @mutex: Mutex
+ *
+ * Return: pthread_mutex_unlock result
+ */
+int lockprof_unlock(pthread_mutex_t *mutex)
+{
+	lockprof_held_t *h = held_find(mutex);
+
+	if (h)
+	{
+		hold_end(h, task_clock_ns());
+		*h = held[--depth];
+	}
+	return (pthread_mutex_unlock(mutex));
+}
+
+/**
+ * lockprof_cond_wait - Waits on a condition variable; the time asleep does
+ *                      not count as holding the mutex
+ *
+ * @cond:  Condition variable
+ * @mutex: Mutex held by the caller
+ *
+ * Return: pthread_cond_wait result
+ */
+int lockprof_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+	lockprof_held_t *h = held_find(mutex);
+	int ret;
+
+	if (h)
+		hold_end(h, task_clock_ns());
+	ret = pthread_cond_wait(cond, mutex);
+	if (h)
+		h->since = task_clock_ns();
+	return (ret);
+}
+
+/**
+ * lockprof_cond_timedwait - pthread_cond_timedwait counterpart of
+ *                           lockprof_cond_wait
+ *
+ * @cond:  Condition variable
+ * @mutex: Mutex held by the caller
+ * @until: Absolute timeout
+ *
+ * Return: pthread_cond_timedwait result
+ */
+int lockprof_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+			    struct timespec const *until)
+{
+	lockprof_held_t *h = held_find(mutex);
+	int ret;
+
+	if (h)
+		hold_end(h, task_clock_ns());
+	ret = pthread_cond_timedwait(cond, mutex, until);
+	if (h)
+		h->since = task_clock_ns();
+	return (ret);
+}
+
+/**
+ * site_compare - qsort comparator ranking sites by total wait, then by
+ *                contended acquisitions
+ *
+ * @a: Pointer to a site pointer
+ * @b: Pointer to a site pointer
+ *
+ * Return: Negative if a ranks first, positive if b does, 0 on a tie
+ */
+static int site_compare(void const *a, void const *b)
+{
+	lockprof_site_t *x = *(lockprof_site_t * const *)a;
+	lockprof_site_t *y = *(lockprof_site_t * const *)b;
+
+	if (LOAD(x->wait_ns) != LOAD(y->wait_ns))
+		return (LOAD(x->wait_ns) < LOAD(y->wait_ns) ? 1 : -1);
+	if (LOAD(x->contended) != LOAD(y->contended))
+		return (LOAD(x->contended) < LOAD(y->contended) ? 1 : -1);
+	return (0);
+}
+
+/**
+ * lockprof_dump - Prints the lock sites, the most serialising first
+ *
+ * @stream: Output stream
+ */
+void lockprof_dump(FILE *stream)
+{
+	lockprof_site_t *first = atomic_load(&sites), *site, **ranked;
+	size_t count = 0, i;
+	char where[64];
+	uint64_t n;
+
+	for (site = first; site; site = site->next)
+		count++;
+	ranked = malloc(sizeof(*ranked) * (count ? count : 1));
+	if (!ranked)
+		return;
+	for (site = first, i = 0; site; site = site->next)
+		ranked[i++] = site;
+	qsort(ranked, count, sizeof(*ranked), site_compare);
+	fprintf(stream, "%-32s %-20s %9s %9s %10s %10s %10s %10s\n",
+		"site", "mutex", "acquired", "contended", "wait (us)",
+		"max (us)", "hold (us)", "max (us)");
+	for (i = 0; i < count; i++)
+	{
+		site = ranked[i];
+		n = LOAD(site->acquired);
+		snprintf(where, sizeof(where), "%s:%d", site->file, site->line);
+		fprintf(stream, "%-32s %-20.20s %9lu %8.1f%% "
+			"%10lu %10lu %10lu %10lu\n", where, site->name,
+			(unsigned long)n,
+			n ? 100.0 * LOAD(site->contended) / n : 0.0,
+			(unsigned long)(LOAD(site->wait_ns) / 1000),
+			(unsigned long)(LOAD(site->wait_max) / 1000),
+			(unsigned long)(LOAD(site->hold_ns) / 1000),
+			(unsigned long)(LOAD(site->hold_max) / 1000));
+	}
+	free(ranked);
+}
+
+/**
+ * lockprof_exit - Prints the report to stderr at exit, if any instrumented
+ *                 mutex was locked
+ */
+__attribute__((destructor)) static void lockprof_exit(void)
+{
+	if (atomic_load(&sites))
+		lockprof_dump(stderr);
+}
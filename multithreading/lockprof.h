@@ -0,0 +1,69 @@
+#ifndef LOCKPROF_H
+#define LOCKPROF_H
+
+#include <pthread.h> /* pthread_mutex_t, pthread_cond_t */
+#include <stdatomic.h> /* atomic_uint_fast64_t */
+#include <stdio.h> /* FILE */
+#include <time.h> /* struct timespec */
+
+/* Mutexes a thread may hold at once and still have their hold time measured */
+#define LOCKPROF_DEPTH 16
+
+/**
+ * struct lockprof_site_s - Contention counters of one pthread_mutex_lock
+ *                          call site, registered on first use
+ *
+ * @file:       Source file of the call
+ * @line:       Source line of the call
+ * @name:       Mutex expression, as written at the call
+ * @registered: Whether the site is in the report list
+ * @acquired:   Number of acquisitions
+ * @contended:  Acquisitions that found the mutex held and had to wait
+ * @wait_ns:    Time spent waiting for the mutex
+ * @wait_max:   Longest wait
+ * @hold_ns:    Time the mutex was held, condition waits excluded
+ * @hold_max:   Longest hold
+ * @next:       Next registered site
+ */
+typedef struct lockprof_site_s
+{
+	char const *file;
+	int line;
+	char const *name;
+	atomic_int registered;
+	atomic_uint_fast64_t acquired;
+	atomic_uint_fast64_t contended;
+	atomic_uint_fast64_t wait_ns;
+	atomic_uint_fast64_t wait_max;
+	atomic_uint_fast64_t hold_ns;
+	atomic_uint_fast64_t hold_max;
+	struct lockprof_site_s *next;
+} lockprof_site_t;
+
+/* lockprof.c */
+int	lockprof_lock(pthread_mutex_t *mutex, lockprof_site_t *site);
+int	lockprof_unlock(pthread_mutex_t *mutex);
+int	lockprof_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+int	lockprof_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+				struct timespec const *until);
+void	lockprof_dump(FILE *stream);
+
+/*
+ * Built with -DLOCKPROF, every mutex operation of the files including this
+ * header goes through the profiler, each pthread_mutex_lock call being its
+ * own site; the ranked report is printed to stderr at exit.
+ */
+#if defined(LOCKPROF) && !defined(LOCKPROF_IMPL)
+#define pthread_mutex_lock(mutex) __extension__ ({			\
+	static lockprof_site_t lockprof_site = {			\
+		.file = __FILE__, .line = __LINE__, .name = #mutex	\
+	};								\
+	lockprof_lock((mutex), &lockprof_site);				\
+})
+#define pthread_mutex_unlock(mutex) lockprof_unlock(mutex)
+#define pthread_cond_wait(cond, mutex) lockprof_cond_wait((cond), (mutex))
+#define pthread_cond_timedwait(cond, mutex, until) \
+	lockprof_cond_timedwait((cond), (mutex), (until))
+#endif
+
+#endif /* LOCKPROF_H */
@@ -4,11 +4,32 @@
 #include <stdint.h> /* uint32_t */
 #include <stddef.h> /* size_t */
 #include <stdio.h> /* printf */
+#include <stdarg.h> /* va_list */
+#include "cancel.h"
 #include "list.h"
+#include "lockprof.h"
+#include "task_stats.h"
 
 pthread_mutex_t tprintf_mutex;
 pthread_mutex_t tasks_mutex;
 
+/* Size of the per-thread buffers of tprintf's buffered mode */
+#define TPRINTF_BUF_SIZE 4096
+
+/* Coroutine tasks: stack size, tasks in flight per worker, pooled stacks */
+#define CORO_STACK_SIZE (64 * 1024)
+#define CORO_MAX_INFLIGHT 4096
+#define CORO_POOL_MAX 1024
+
+/* Threads of the parallel_for pool, the caller included */
+#define PARALLEL_MAX_THREADS 64
+
+/* img_alloc: huge page size, row alignment in bytes, and flags */
+#define IMG_HUGEPAGE_SIZE (2UL << 20)
+#define IMG_ROW_ALIGN 64
+#define IMG_HUGEPAGE 1 /* Transparent huge pages, through madvise */
+#define IMG_HUGETLB 2 /* Reserved huge pages, else as IMG_HUGEPAGE */
+
 /**
 * struct pixel_s - RGB pixel
 *
@@ -38,6 +59,19 @@ typedef struct img_s
 	pixel_t *pixels;
 } img_t;
 
+/**
+* struct img_buf_s - Image allocated by img_alloc, its rows padded to start
+*                    on cache lines; blurred with blur_image_buf
+*
+* @img:    Image; its pixels start with the first row
+* @stride: Distance between the starts of two rows, in pixels
+*/
+typedef struct img_buf_s
+{
+	img_t img;
+	size_t stride;
+} img_buf_t;
+
 /**
 * struct kernel_s - Convolution kernel
 *
@@ -77,6 +111,22 @@ typedef struct blur_portion_s
 
 typedef void *(*task_entry_t)(void *);
 
+/**
+* struct range_s - Half-open range of indices [begin, end)
+*
+* @begin: First index
+* @end:   Index past the last one
+*/
+typedef struct range_s
+{
+	size_t begin;
+	size_t end;
+} range_t;
+
+typedef void (*range_func_t)(range_t const *range, void *ctx);
+typedef void (*reduce_func_t)(range_t const *range, void *ctx, void *acc);
+typedef void (*combine_func_t)(void *acc, void const *other, void *ctx);
+
 /**
 * enum task_status_e - Task status
 *
@@ -84,6 +134,7 @@ typedef void *(*task_entry_t)(void *);
 * @STARTED: Task has started
 * @SUCCESS: Task has completed successfully
 * @FAILURE: Task has completed with issues
+* @CANCELLED: Task was cancelled, or timed out, before completing
 */
 typedef enum task_status_e
 {
@@ -91,9 +142,28 @@ typedef enum task_status_e
 	STARTED,
 	SUCCESS,
 	FAILURE,
+	CANCELLED,
 	TASK_STATUS_MAX /* Number of task statuses */
 } task_status_t;
 
+/**
+* enum task_priority_e - Task priority level, served by exec_tasks_sched
+*
+* @TASK_PRIO_URGENT: Latency-sensitive task
+* @TASK_PRIO_NORMAL: Default priority
+* @TASK_PRIO_BULK:   Throughput work, such as batch factoring
+*/
+typedef enum task_priority_e
+{
+	TASK_PRIO_URGENT = 0,
+	TASK_PRIO_NORMAL,
+	TASK_PRIO_BULK,
+	TASK_PRIO_MAX /* Number of priority levels */
+} task_priority_t;
+
+/* Wait promoting a ready task by one priority level in exec_tasks_sched */
+#define TASK_AGING_NS 50000000ULL
+
 /**
 * struct task_s - Executable task structure
 *
@@ -102,6 +172,19 @@ typedef enum task_status_e
 * @status: Task status, default to PENDING
 * @result: Stores the return value of the entry function
 * @lock:   Task mutex
+* @id:     Task identifier, used in logs
+* @free_result: Function releasing the result in destroy_task; NULL for
+*              the list_t of individually allocated factors made by
+*              prime_factors
+* @enqueued_ns: Creation time, from task_clock_ns, to measure queue wait
+* @priority: Priority level, default to TASK_PRIO_NORMAL
+* @deadline_ns: Deadline on the task_clock_ns clock, or 0 for none
+* @cancelled: Cancellation token, polled by the entry via cancel_requested
+* @timeout_ns: Run time after which the task is cancelled, or 0 for none
+* @timer_slot: Index of the task in the timer heap plus one, 0 when its
+*              timeout is not armed; guarded by the timer lock
+* @wake_fd: Eventfd of the coroutine worker the task is parked in, or -1;
+*           guarded by @lock
 */
 typedef struct task_s
 {
@@ -113,18 +196,53 @@ typedef struct task_s
 
 	pthread_mutex_t lock;
 	unsigned int id;
+	node_func_t free_result;
+	uint64_t enqueued_ns;
+	task_priority_t priority;
+	uint64_t deadline_ns;
+	cancel_token_t cancelled;
+	uint64_t timeout_ns;
+	size_t timer_slot;
+	int wake_fd;
 
 } task_t;
 
+typedef struct task_sched_s task_sched_t;
+
 /*Functions prototypes*/
 void *thread_entry(void *arg);
 int tprintf(char const *format, ...);
+int vtprintf_buffered(char const *format, va_list args);
+int tprintf_set_buffered(int enable);
+int tprintf_is_buffered(void);
+void tprintf_flush(void);
 void blur_portion(blur_portion_t const *portion);
 void blur_image(img_t *img_blur, img_t const *img, kernel_t const *kernel);
+void blur_image_buf(img_buf_t *img_blur, img_buf_t const *img,
+		    kernel_t const *kernel);
+int img_alloc(img_buf_t *buf, size_t w, size_t h, int flags);
+void img_free(img_buf_t *buf);
 list_t *prime_factors(char const *s);
 task_t *create_task(task_entry_t entry, void *param);
 void destroy_task(task_t *task);
 void *exec_tasks(list_t const *tasks);
+void *exec_tasks_quiet(list_t const *tasks);
+int claim_task(task_t *task);
+void run_task(task_t *task, task_worker_stats_t *stats, int verbose);
+task_sched_t *sched_create(list_t const *tasks);
+int sched_submit(task_sched_t *sched, task_t *task);
+void *exec_tasks_sched(task_sched_t *sched);
+void sched_destroy(task_sched_t *sched);
+int cancel_task(task_t *task);
+int task_timer_arm(task_t *task);
+void task_timer_disarm(task_t *task);
+void *exec_tasks_coro(list_t const *tasks);
+int coro_wait_fd(int fd, uint32_t events);
+void coro_yield(void);
+void parallel_for(range_t range, size_t grain, range_func_t fn, void *ctx);
+int parallel_reduce(range_t range, size_t grain, reduce_func_t map,
+		    combine_func_t combine, void *ctx, void *result,
+		    size_t size);
 task_status_t get_task_status(task_t *task);
 void set_task_status(task_t *task, task_status_t status);
 void *exec_task(task_t *task);
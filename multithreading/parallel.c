@@ -0,0 +1,294 @@
+#include "multithreading.h"
+#include "topology.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Chunks per thread when the grain is chosen automatically */
+#define PARALLEL_CHUNKS_PER_THREAD 4
+
+/**
+ * struct par_job_s - Range split into chunks, run by the caller and any
+ *                    idle pool thread
+ *
+ * @range:   Whole range
+ * @grain:   Length of a chunk
+ * @nchunks: Number of chunks
+ * @next:    Next chunk to claim
+ * @active:  Pool threads working on the job, guarded by the pool lock
+ * @fn:      parallel_for body, or NULL
+ * @map:     parallel_reduce body, or NULL
+ * @ctx:     Body context
+ * @accs:    Accumulators of parallel_reduce, one per thread slot
+ * @size:    Size of an accumulator
+ * @used:    Whether each accumulator received a chunk
+ * @l3:      L3 domain of the caller, -1 if unknown
+ * @next_job: Next job of the pool
+ */
+typedef struct par_job_s
+{
+	range_t range;
+	size_t grain;
+	size_t nchunks;
+	atomic_size_t next;
+	int active;
+	range_func_t fn;
+	reduce_func_t map;
+	void *ctx;
+	char *accs;
+	size_t size;
+	char *used;
+	int l3;
+	struct par_job_s *next_job;
+} par_job_t;
+
+/**
+ * struct par_pool_s - Threads shared by every parallel_for and
+ *                     parallel_reduce call
+ *
+ * @lock:     Guards the job list and the active counters
+ * @work:     Signalled when a job is published
+ * @done:     Signalled when a pool thread leaves a job
+ * @jobs:     Jobs with chunks left to claim
+ * @nthreads: Number of pool threads, the callers not included
+ */
+typedef struct par_pool_s
+{
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+	par_job_t *jobs;
+	int nthreads;
+} par_pool_t;
+
+static par_pool_t pool = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+	PTHREAD_COND_INITIALIZER, NULL, 0
+};
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+/* Accumulator slot of a pool thread; a job's caller uses slot 0 */
+static __thread int tls_slot;
+
+/**
+ * job_run - Claims and runs chunks of a job until none is left
+ *
+ * @job:  Job
+ * @slot: Accumulator slot of the calling thread
+ */
+static void job_run(par_job_t *job, int slot)
+{
+	range_t chunk;
+	size_t i;
+
+	while ((i = atomic_fetch_add(&job->next, 1)) < job->nchunks)
+	{
+		chunk.begin = job->range.begin + i * job->grain;
+		chunk.end = chunk.begin + job->grain < job->range.end ?
+			chunk.begin + job->grain : job->range.end;
+		if (job->fn)
+			job->fn(&chunk, job->ctx);
+		else
+		{
+			job->map(&chunk, job->ctx,
+				 job->accs + slot * job->size);
+			job->used[slot] = 1;
+		}
+	}
+}
+
+/**
+ * job_unlink - Removes a job whose chunks are all claimed from the pool
+ *
+ * @job: Job, the pool being locked
+ */
+static void job_unlink(par_job_t *job)
+{
+	par_job_t **link;
+
+	for (link = &pool.jobs; *link; link = &(*link)->next_job)
+		if (*link == job)
+		{
+			*link = job->next_job;
+			break;
+		}
+}
+
+/**
+ * job_pick - Chooses a job to help with, preferring the jobs whose caller
+ *            shares the helper's L3 cache, whose data is likely there
+ *
+ * @l3: L3 domain of the helper
+ *
+ * Return: Job, or NULL if none is published; the pool being locked
+ */
+static par_job_t *job_pick(int l3)
+{
+	par_job_t *job;
+
+	for (job = pool.jobs; job; job = job->next_job)
+		if (job->l3 == l3)
+			return (job);
+	return (pool.jobs);
+}
+
+/**
+ * pool_thread - Pool thread: pinned to a placement slot of its own, helps
+ *               with the published jobs
+ *
+ * @arg: Accumulator slot of the thread
+ *
+ * Return: Never returns
+ */
+static void *pool_thread(void *arg)
+{
+	cpu_info_t const *cpu;
+	par_job_t *job;
+	int l3;
+
+	tls_slot = (int)(intptr_t)arg;
+	cpu = topology_cpu(topology_pin(topology_claim_slot()));
+	l3 = cpu ? cpu->l3 : -1;
+	pthread_mutex_lock(&pool.lock);
+	for (;;)
+	{
+		while (!(job = job_pick(l3)))
+			pthread_cond_wait(&pool.work, &pool.lock);
+		job->active++;
+		pthread_mutex_unlock(&pool.lock);
+		job_run(job, tls_slot);
+		pthread_mutex_lock(&pool.lock);
+		job_unlink(job);
+		job->active--;
+		pthread_cond_broadcast(&pool.done);
+	}
+	return (NULL);
+}
+
+/**
+ * pool_init - Starts one pool thread per extra physical core of the
+ *             inherited affinity mask, once: compute kernels gain little
+ *             from a second thread on an SMT sibling
+ */
+static void pool_init(void)
+{
+	int cpus = topology_get()->allowed_cores, t;
+	pthread_t thread;
+
+	cpus = cpus > PARALLEL_MAX_THREADS ? PARALLEL_MAX_THREADS : cpus;
+	for (t = 1; t < cpus; t++)
+	{
+		if (pthread_create(&thread, NULL, pool_thread,
+				   (void *)(intptr_t)t))
+			break;
+		pthread_detach(thread);
+		pool.nthreads = t;
+	}
+}
+
+/**
+ * job_exec - Publishes a job, runs its chunks and waits for the pool
+ *            threads that helped
+ *
+ * @job:   Job, with its range, body and context set
+ * @grain: Chunk length, or 0 to choose it from the number of threads
+ */
+static void job_exec(par_job_t *job, size_t grain)
+{
+	size_t len = job->range.end - job->range.begin, chunks;
+
+	pthread_once(&pool_once, pool_init);
+	chunks = (size_t)(pool.nthreads + 1) * PARALLEL_CHUNKS_PER_THREAD;
+	job->grain = grain ? grain : (len + chunks - 1) / chunks;
+	job->grain = job->grain ? job->grain : 1;
+	job->nchunks = (len + job->grain - 1) / job->grain;
+	atomic_init(&job->next, 0);
+	job->active = 0;
+	job->l3 = topology_current_l3();
+	if (job->nchunks > 1 && pool.nthreads)
+	{
+		pthread_mutex_lock(&pool.lock);
+		job->next_job = pool.jobs;
+		pool.jobs = job;
+		pthread_cond_broadcast(&pool.work);
+		pthread_mutex_unlock(&pool.lock);
+	}
+	job_run(job, 0);
+	if (job->nchunks > 1 && pool.nthreads)
+	{
+		pthread_mutex_lock(&pool.lock);
+		job_unlink(job);
+		while (job->active)
+			pthread_cond_wait(&pool.done, &pool.lock);
+		pthread_mutex_unlock(&pool.lock);
+	}
+}
+
+/**
+ * parallel_for - Calls a function on chunks of a range, in parallel on the
+ *                shared pool and the calling thread; returns once every
+ *                chunk is done. Calls may be nested or concurrent.
+ *
+ * @range: Range of indices
+ * @grain: Chunk length, or 0 to split the range into a few chunks per thread
+ * @fn:    Function called on each chunk
+ * @ctx:   Context passed to @fn
+ */
+void parallel_for(range_t range, size_t grain, range_func_t fn, void *ctx)
+{
+	par_job_t job;
+
+	if (range.end <= range.begin)
+		return;
+	memset(&job, 0, sizeof(job));
+	job.range = range;
+	job.fn = fn;
+	job.ctx = ctx;
+	job_exec(&job, grain);
+}
+
+/**
+ * parallel_reduce - Folds a range in parallel: every thread accumulates the
+ *                   chunks it runs into its own copy of the initial value,
+ *                   and the copies are then combined into @result
+ *
+ * @range:   Range of indices
+ * @grain:   Chunk length, or 0 to choose it
+ * @map:     Function folding a chunk into an accumulator
+ * @combine: Function folding an accumulator into another; with @map, it must
+ *           not depend on the order of the chunks
+ * @ctx:     Context passed to @map and @combine
+ * @result:  Initial (identity) value, replaced by the result
+ * @size:    Size of @result
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+int parallel_reduce(range_t range, size_t grain, reduce_func_t map,
+		    combine_func_t combine, void *ctx, void *result,
+		    size_t size)
+{
+	size_t slots, s;
+	par_job_t job;
+
+	if (range.end <= range.begin)
+		return (0);
+	pthread_once(&pool_once, pool_init);
+	slots = (size_t)pool.nthreads + 1;
+	memset(&job, 0, sizeof(job));
+	job.accs = malloc(slots * size);
+	job.used = calloc(slots, 1);
+	if (!job.accs || !job.used)
+		return (free(job.accs), free(job.used), -1);
+	for (s = 0; s < slots; s++)
+		memcpy(job.accs + s * size, result, size);
+	job.range = range;
+	job.map = map;
+	job.ctx = ctx;
+	job.size = size;
+	job_exec(&job, grain);
+	for (s = 0; s < slots; s++)
+		if (job.used[s])
+			combine(result, job.accs + s * size, ctx);
+	free(job.accs);
+	free(job.used);
+	return (0);
+}
@@ -0,0 +1,241 @@
+#include "multithreading.h"
+#include "factor.h"
+#include "sieve.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * struct batch_chunk_s - Slice of a batch, factored by a single task
+ *
+ * @numbers:   First number of the slice
+ * @count:     Number of numbers in the slice
+ * @divisors:  Odd trial primes with their reciprocals, shared by the batch
+ * @ndivisors: Number of trial primes
+ * @counts:    Number of factors of each number, filled by the task
+ * @total:     Number of factors of the slice, filled by the task
+ * @factors:   Factors of the slice, stored contiguously, filled by the task
+ */
+typedef struct batch_chunk_s
+{
+	uint64_t const *numbers;
+	size_t count;
+	divisor_t const *divisors;
+	size_t ndivisors;
+	size_t counts[BATCH_CHUNK];
+	size_t total;
+	uint64_t *factors;
+} batch_chunk_t;
+
+/**
+ * make_divisors - Precomputes the reciprocals of the odd trial primes
+ *
+ * @count: Where to store the number of divisors
+ *
+ * Return: Malloc'd array of divisors, or NULL
+ */
+static divisor_t *make_divisors(size_t *count)
+{
+	prime_table_t const *table = sieve_primes(FACTOR_TRIAL_LIMIT + 1);
+	divisor_t *divisors = malloc(sizeof(*divisors) * table->count);
+	uint64_t p, inv;
+	size_t i;
+	int j;
+
+	*count = 0;
+	for (i = 1; divisors && i < table->count; i++)
+	{
+		p = table->primes[i];
+		if (p > FACTOR_TRIAL_LIMIT)
+			break;
+		for (inv = p, j = 0; j < 5; j++)
+			inv *= 2 - p * inv;
+		divisors[*count].p = p;
+		divisors[*count].inv = inv;
+		divisors[*count].lim = UINT64_MAX / p;
+		++*count;
+	}
+	return (divisors);
+}
+
+/**
+ * chunk_trial - Trial-divides every number of a chunk by the same prime at
+ *               once; the divisibility test is a branch-free multiply and
+ *               compare that compilers turn into SIMD code
+ *
+ * @d:     Trial divisor
+ * @rem:   Remaining cofactor of each number, updated in place
+ * @slots: Factors found for each number
+ * @cnt:   Number of factors found for each number
+ * @n:     Number of numbers
+ */
+static void chunk_trial(divisor_t const *d, uint64_t *rem,
+			uint64_t (*slots)[FACTORS_MAX], size_t *cnt, size_t n)
+{
+	uint8_t hit[BATCH_CHUNK];
+	unsigned int any = 0;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		hit[i] = rem[i] * d->inv <= d->lim;
+		any |= hit[i];
+	}
+	if (!any)
+		return;
+	for (i = 0; i < n; i++)
+		for (; hit[i] && rem[i] * d->inv <= d->lim; rem[i] *= d->inv)
+			slots[i][cnt[i]++] = d->p;
+}
+
+/**
+ * factor_chunk - Factors one chunk of a batch
+ *
+ * @chunk: Chunk; its factors stay NULL on allocation failure or if the
+ *         running task is cancelled
+ */
+static void factor_chunk(batch_chunk_t *chunk)
+{
+	uint64_t (*slots)[FACTORS_MAX] = malloc(sizeof(*slots) * chunk->count);
+	uint64_t rem[BATCH_CHUNK];
+	size_t i, total = 0, large, *cnt = chunk->counts;
+
+	if (!slots)
+		return;
+	for (i = 0; i < chunk->count; i++)
+	{
+		rem[i] = chunk->numbers[i] < 2 ? 1 : chunk->numbers[i];
+		for (cnt[i] = 0; !(rem[i] & 1); rem[i] >>= 1)
+			slots[i][cnt[i]++] = 2;
+	}
+	for (i = 0; i < chunk->ndivisors; i++)
+		chunk_trial(&chunk->divisors[i], rem, slots, cnt, chunk->count);
+	for (i = 0; i < chunk->count; i++)
+	{
+		if (rem[i] <= (uint64_t)FACTOR_TRIAL_LIMIT * FACTOR_TRIAL_LIMIT)
+			slots[i][cnt[i]] = rem[i], cnt[i] += rem[i] > 1;
+		else if ((large = factor_large(rem[i], slots[i] + cnt[i])) ==
+			 FACTORS_CANCELLED)
+		{
+			free(slots);
+			return;
+		}
+		else
+			cnt[i] += large;
+		total += cnt[i];
+	}
+	chunk->factors = malloc(sizeof(uint64_t) * (total + 1));
+	for (i = 0, total = 0; chunk->factors && i < chunk->count; i++)
+	{
+		memcpy(chunk->factors + total, slots[i],
+		       sizeof(uint64_t) * cnt[i]);
+		total += cnt[i];
+	}
+	chunk->total = total;
+	free(slots);
+}
+
+/**
+ * factor_chunks - parallel_for body factoring a range of chunks
+ *
+ * @range: Indices of the chunks
+ * @ctx:   Array of chunks
+ */
+static void factor_chunks(range_t const *range, void *ctx)
+{
+	batch_chunk_t *chunks = ctx;
+	size_t i;
+
+	for (i = range->begin; i < range->end; i++)
+		factor_chunk(&chunks[i]);
+}
+
+/**
+ * batch_collect - Gathers the results of every chunk into one batch
+ *
+ * @chunks:  Factored chunks
+ * @nchunks: Number of chunks
+ * @count:   Number of numbers in the batch
+ *
+ * Return: Batch, or NULL on failure
+ */
+static factor_batch_t *batch_collect(batch_chunk_t const *chunks,
+				     size_t nchunks, size_t count)
+{
+	factor_batch_t *batch = calloc(1, sizeof(*batch));
+	size_t i, j, k, *offsets;
+
+	for (i = 0, k = 0; i < nchunks; k += chunks[i++].total)
+		if (!chunks[i].factors)
+			return (free(batch), NULL);
+	if (!batch)
+		return (NULL);
+	batch->count = count;
+	batch->offsets = offsets = malloc(sizeof(size_t) * (count + 1));
+	batch->factors = malloc(sizeof(uint64_t) * (k + 1));
+	if (!batch->offsets || !batch->factors)
+		return (factor_batch_destroy(batch), NULL);
+	for (i = 0, k = 0; i < nchunks; i++)
+	{
+		memcpy(batch->factors + k, chunks[i].factors,
+		       sizeof(uint64_t) * chunks[i].total);
+		for (j = 0; j < chunks[i].count; k += chunks[i].counts[j++])
+			*offsets++ = k;
+	}
+	*offsets = k;
+	return (batch);
+}
+
+/**
+ * prime_factors_batch - Factors an array of numbers in parallel, splitting
+ *                       it into chunks spread over the parallel_for pool
+ *
+ * @numbers: Numbers to factor
+ * @count:   Number of numbers
+ *
+ * Return: Factors of every number, to be freed with factor_batch_destroy,
+ * or NULL on failure or if the running task is cancelled
+ */
+factor_batch_t *prime_factors_batch(uint64_t const *numbers, size_t count)
+{
+	size_t nchunks = (count + BATCH_CHUNK - 1) / BATCH_CHUNK, ndiv, i;
+	batch_chunk_t *chunks = calloc(nchunks + 1, sizeof(*chunks));
+	divisor_t *divisors = make_divisors(&ndiv);
+	factor_batch_t *batch = NULL;
+	range_t range;
+
+	for (i = 0; chunks && divisors && i < nchunks; i++)
+	{
+		chunks[i].numbers = numbers + i * BATCH_CHUNK;
+		chunks[i].count = i + 1 < nchunks ? BATCH_CHUNK :
+			count - i * BATCH_CHUNK;
+		chunks[i].divisors = divisors;
+		chunks[i].ndivisors = ndiv;
+	}
+	if (chunks && divisors)
+	{
+		range.begin = 0;
+		range.end = nchunks;
+		parallel_for(range, 1, factor_chunks, chunks);
+		batch = batch_collect(chunks, nchunks, count);
+	}
+	for (i = 0; chunks && i < nchunks; i++)
+		free(chunks[i].factors);
+	free(chunks);
+	free(divisors);
+	return (batch);
+}
+
+/**
+ * factor_batch_destroy - Frees the result of prime_factors_batch
+ *
+ * @batch: Batch to free
+ */
+void factor_batch_destroy(factor_batch_t *batch)
+{
+	if (batch)
+	{
+		free(batch->offsets);
+		free(batch->factors);
+		free(batch);
+	}
+}
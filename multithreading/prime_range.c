@@ -0,0 +1,679 @@
+#include "multithreading.h"
+#include "sieve.h"
+#include "topology.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Numbers of [0, 30) coprime to 30; bit b of a byte stands for wheel[b] */
+static uint8_t const wheel[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+/* Bit of each residue coprime to 30 */
+static uint8_t const wheel_bit[30] = {
+	0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 2, 0, 3, 0,
+	0, 0, 4, 0, 5, 0, 0, 0, 6, 0, 0, 0, 0, 0, 7
+};
+/* Distance from each residue to the next one coprime to 30 */
+static uint8_t const coprime_gap[30] = {
+	1, 0, 5, 4, 3, 2, 1, 0, 3, 2, 1, 0, 1, 0, 3,
+	2, 1, 0, 1, 0, 3, 2, 1, 0, 5, 4, 3, 2, 1, 0
+};
+/* Distance from wheel[b] to the next number coprime to 30 */
+static uint8_t const wheel_gap[8] = {6, 4, 2, 4, 2, 4, 6, 2};
+/* Primes skipped by the wheel */
+static uint8_t const wheel_primes[3] = {2, 3, 5};
+
+/**
+ * struct sieve_job_s - Parallel sieve of segments of a range
+ *
+ * @range:  Range
+ * @window: Where the segments are stored, NULL when counting
+ * @first:  Segment stored at the start of window
+ * @failed: Set if a worker could not allocate its scratch memory
+ */
+typedef struct sieve_job_s
+{
+	sieve_range_t const *range;
+	uint8_t *window;
+	uint64_t first;
+	atomic_int failed;
+} sieve_job_t;
+
+/* Entries per bucket block, so that a block spans 4 KiB */
+#define BUCKET_SIZE 255
+
+/**
+ * struct sieve_hit_s - Next multiple p * q to cross off of a large sieving
+ *                      prime
+ *
+ * @pos: Byte of the multiple, from the start of the range
+ * @p:   Prime
+ * @k:   Index of q mod 30 in the wheel
+ */
+typedef struct sieve_hit_s
+{
+	uint64_t pos;
+	uint32_t p;
+	uint32_t k;
+} sieve_hit_t;
+
+/**
+ * struct sieve_block_s - Block of entries of a bucket
+ *
+ * @next:  Next block of the bucket, or of the free list
+ * @count: Number of entries in the block
+ * @hits:  Entries
+ */
+typedef struct sieve_block_s
+{
+	struct sieve_block_s *next;
+	size_t count;
+	sieve_hit_t hits[BUCKET_SIZE];
+} sieve_block_t;
+
+/**
+ * struct sieve_buckets_s - Large sieving primes of a run of segments, each
+ *                          filed in the bucket of the segment holding its
+ *                          next multiple, so that a segment only reads, in
+ *                          sequence, the primes hitting it
+ *
+ * @heads: Blocks of each bucket, a ring indexed by segment
+ * @mask:  Number of buckets minus one, a power of two minus one
+ * @free:  Emptied blocks, kept for reuse
+ * @next:  Index of the next large prime to put in use
+ * @end:   End byte of the run of segments; later multiples are dropped
+ */
+typedef struct sieve_buckets_s
+{
+	sieve_block_t **heads;
+	size_t mask;
+	sieve_block_t *free;
+	size_t next;
+	uint64_t end;
+} sieve_buckets_t;
+
+/**
+ * isqrt - Computes an integer square root
+ *
+ * @n: Number
+ *
+ * Return: Largest r such that r * r <= n
+ */
+static uint64_t isqrt(uint64_t n)
+{
+	uint64_t root = 0, bit = 1ULL << 62;
+
+	while (bit > n)
+		bit >>= 2;
+	for (; bit; bit >>= 2)
+		if (n >= root + bit)
+		{
+			n -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+			root >>= 1;
+	return (root);
+}
+
+/**
+ * primes_below - Counts the primes of a table lower than a bound
+ *
+ * @table: Prime table
+ * @bound: Bound
+ *
+ * Return: Number of primes lower than @bound
+ */
+static size_t primes_below(prime_table_t const *table, uint64_t bound)
+{
+	size_t lo = 0, hi = table->count, mid;
+
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (table->primes[mid] < bound)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo);
+}
+
+/**
+ * range_init - Prepares the sieve of a range. The sieving primes come from
+ *              the shared prime table, extended up to the square root of
+ *              the end: near SIEVE_RANGE_MAX, that is every prime below
+ *              2^32, about 800 MiB once listed.
+ *
+ * @range: Range to set up
+ * @lo:    First number
+ * @hi:    End, excluded; capped to SIEVE_RANGE_MAX
+ *
+ * Return: 0 on success, -1 if the sieving primes cannot be listed
+ */
+static int range_init(sieve_range_t *range, uint64_t lo, uint64_t hi)
+{
+	prime_table_t const *table;
+	uint64_t root;
+
+	memset(range, 0, sizeof(*range));
+	hi = hi > SIEVE_RANGE_MAX ? SIEVE_RANGE_MAX : hi;
+	range->lo = lo;
+	range->hi = hi > lo ? hi : lo;
+	range->start = lo / 30 * 30;
+	if (range->hi == range->lo)
+		return (0);
+	range->nbytes = (range->hi - range->start + 29) / 30;
+	root = isqrt(range->hi - 1);
+	if (root < 7)
+		return (0);
+	table = sieve_primes(root + 1);
+	if (table->limit < root + 1)
+		return (-1);
+	/* The table starts with 2, 3 and 5, which the wheel already skips */
+	range->primes = table->primes + 3;
+	range->nprimes = primes_below(table, root + 1) - 3;
+	range->nsmall = primes_below(table, SIEVE_SEGMENT) - 3;
+	range->nsmall = range->nsmall < range->nprimes ? range->nsmall :
+		range->nprimes;
+	return (0);
+}
+
+/**
+ * wheel_offsets - Locates the first multiple to cross off of a small
+ *                 sieving prime in each of its 8 residue classes: the
+ *                 multiples p * q with q = wheel[k] (mod 30) all fall on the
+ *                 same bit, p bytes apart
+ *
+ * @p:   Sieving prime
+ * @lo:  Number of the first byte of the segment, multiple of 30
+ * @off: Where to store the byte offset, from @lo, of the first multiple of
+ *       each class not lower than both @lo and p * p
+ */
+static void wheel_offsets(uint64_t p, uint64_t lo, uint32_t *off)
+{
+	uint64_t q0 = (lo + p - 1) / p, q, rem;
+	int k;
+
+	q0 = q0 < p ? p : q0;
+	rem = p * q0 - lo;
+	for (k = 0; k < 8; k++)
+	{
+		q = q0 / 30 * 30 + wheel[k];
+		q += q < q0 ? 30 : 0;
+		off[k] = (uint32_t)((p * (q - q0) + rem) / 30);
+	}
+}
+
+/**
+ * cross_off - Crosses off the multiples of a small sieving prime in a
+ *             segment
+ *
+ * @seg: Segment
+ * @n:   Number of bytes in the segment
+ * @p:   Sieving prime
+ * @off: Offsets of the first multiple of each class, replaced by the
+ *       offsets from the next segment
+ */
+static void cross_off(uint8_t *seg, size_t n, uint32_t p, uint32_t *off)
+{
+	unsigned int r = p % 30;
+	uint8_t mask;
+	uint32_t j;
+	int k;
+
+	for (k = 0; k < 8; k++)
+	{
+		mask = (uint8_t)~(1U << wheel_bit[r * wheel[k] % 30]);
+		for (j = off[k]; j < n; j += p)
+			seg[j] &= mask;
+		off[k] = j - n;
+	}
+}
+
+/**
+ * buckets_init - Prepares the buckets of a run of segments
+ *
+ * @b:     Buckets to set up
+ * @range: Range
+ * @segs:  Segments of the run
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int buckets_init(sieve_buckets_t *b, sieve_range_t const *range,
+			range_t const *segs)
+{
+	size_t ahead = 2;
+
+	memset(b, 0, sizeof(*b));
+	b->next = range->nsmall;
+	b->end = segs->end * SIEVE_SEGMENT < range->nbytes ?
+		segs->end * SIEVE_SEGMENT : range->nbytes;
+	if (range->nsmall == range->nprimes)
+		return (0);
+	/* A step to the next multiple spans at most 6 * p numbers */
+	while (ahead < 6 * (uint64_t)range->primes[range->nprimes - 1] /
+	       SIEVE_SEGMENT_SPAN + 2)
+		ahead *= 2;
+	b->heads = calloc(ahead, sizeof(*b->heads));
+	b->mask = ahead - 1;
+	return (b->heads ? 0 : -1);
+}
+
+/**
+ * buckets_free - Frees the blocks of the buckets
+ *
+ * @b: Buckets
+ */
+static void buckets_free(sieve_buckets_t *b)
+{
+	sieve_block_t *block;
+	size_t i;
+
+	for (i = 0; b->heads && i <= b->mask; i++)
+		while ((block = b->heads[i]))
+			b->heads[i] = block->next, free(block);
+	while ((block = b->free))
+		b->free = block->next, free(block);
+	free(b->heads);
+}
+
+/**
+ * bucket_file - Files a large sieving prime in the bucket of the segment
+ *               holding its next multiple
+ *
+ * @b:   Buckets
+ * @pos: Byte of the next multiple
+ * @p:   Prime
+ * @k:   Wheel index of the next multiple's cofactor
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int bucket_file(sieve_buckets_t *b, uint64_t pos, uint32_t p,
+		       uint32_t k)
+{
+	sieve_block_t **head = &b->heads[pos / SIEVE_SEGMENT & b->mask];
+	sieve_block_t *block = *head;
+	sieve_hit_t *h;
+
+	if (!block || block->count == BUCKET_SIZE)
+	{
+		block = b->free;
+		if (block)
+			b->free = block->next;
+		else if (!(block = malloc(sizeof(*block))))
+			return (-1);
+		block->next = *head;
+		block->count = 0;
+		*head = block;
+	}
+	h = &block->hits[block->count++];
+	h->pos = pos;
+	h->p = p;
+	h->k = k;
+	return (0);
+}
+
+/**
+ * bucket_sieve - Crosses off the next multiple of each prime of a bucket
+ *                block, which falls in the segment, then files the prime
+ *                again by the multiple after it. Multiples are walked along
+ *                the wheel: for p = 30a + rp, the step from p * q to
+ *                p * (q + g) is a * g + (p * q mod 30 + rp * g) / 30 bytes,
+ *                so the walk needs no division.
+ *
+ * @b:     Buckets
+ * @block: Block, detached from its bucket
+ * @seg:   Segment
+ * @first: Byte of the start of the segment
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int bucket_sieve(sieve_buckets_t *b, sieve_block_t const *block,
+			uint8_t *seg, uint64_t first)
+{
+	unsigned int rp, r, g, k;
+	sieve_hit_t const *h;
+	uint64_t step;
+
+	for (h = block->hits; h < block->hits + block->count; h++)
+	{
+		rp = h->p % 30;
+		k = h->k;
+		r = rp * wheel[k] % 30;
+		seg[h->pos - first] &= (uint8_t)~(1U << wheel_bit[r]);
+		g = wheel_gap[k];
+		step = (uint64_t)(h->p / 30) * g + (r + rp * g) / 30;
+		/* Met again by sieve_large if still in this segment */
+		if (b->end - h->pos > step &&
+		    bucket_file(b, h->pos + step, h->p, (k + 1) & 7))
+			return (-1);
+	}
+	return (0);
+}
+
+/**
+ * sieve_large - Crosses off the multiples of the large sieving primes that
+ *               fall in a segment, emptying its bucket until no prime is
+ *               filed there again; the primes whose square falls in the
+ *               segment are put in use first
+ *
+ * @b:     Buckets
+ * @range: Range
+ * @seg:   Segment
+ * @s:     Index of the segment
+ * @n:     Number of bytes in the segment
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int sieve_large(sieve_buckets_t *b, sieve_range_t const *range,
+		       uint8_t *seg, uint64_t s, size_t n)
+{
+	uint64_t lo = range->start + s * SIEVE_SEGMENT_SPAN, p, q;
+	uint64_t last = range->start + 30 * b->end - 1;
+	sieve_block_t *block;
+	int ret = 0;
+
+	for (; b->heads && b->next < range->nprimes; b->next++)
+	{
+		p = range->primes[b->next];
+		if (p * p >= lo + 30 * n)
+			break;
+		q = (lo + p - 1) / p;
+		q = q < p ? p : q;
+		q += coprime_gap[q % 30];
+		if (q > last / p)
+			continue;
+		if (bucket_file(b, (p * q - range->start) / 30, (uint32_t)p,
+				wheel_bit[q % 30]))
+			return (-1);
+	}
+	while (b->heads && (block = b->heads[s & b->mask]))
+	{
+		b->heads[s & b->mask] = block->next;
+		if (!ret)
+			ret = bucket_sieve(b, block, seg, s * SIEVE_SEGMENT);
+		block->next = b->free;
+		b->free = block;
+	}
+	return (ret);
+}
+
+/**
+ * mask_ends - Clears the bits of the numbers out of the range, and of 1
+ *
+ * @range: Range
+ * @seg:   Segment
+ * @s:     Index of the segment
+ * @n:     Number of bytes in the segment
+ */
+static void mask_ends(sieve_range_t const *range, uint8_t *seg, uint64_t s,
+		      size_t n)
+{
+	uint64_t last = range->start + 30 * (s * SIEVE_SEGMENT + n - 1);
+	int b;
+
+	for (b = 0; b < 8; b++)
+	{
+		if (!s && (range->start + wheel[b] < range->lo ||
+			   range->start + wheel[b] == 1))
+			seg[0] &= (uint8_t)~(1U << b);
+		if (s * SIEVE_SEGMENT + n == range->nbytes &&
+		    last + wheel[b] >= range->hi)
+			seg[n - 1] &= (uint8_t)~(1U << b);
+	}
+}
+
+/**
+ * popcount - Counts the primes left in a segment
+ *
+ * @seg: Segment
+ * @n:   Number of bytes in the segment
+ *
+ * Return: Number of bits set
+ */
+static uint64_t popcount(uint8_t const *seg, size_t n)
+{
+	uint64_t word, count = 0;
+	size_t i;
+
+	for (i = 0; i + sizeof(word) <= n; i += sizeof(word))
+	{
+		memcpy(&word, seg + i, sizeof(word));
+		count += __builtin_popcountll(word);
+	}
+	for (; i < n; i++)
+		count += __builtin_popcount(seg[i]);
+	return (count);
+}
+
+/**
+ * sieve_segments - Sieves consecutive segments of a range. The offsets of
+ *                  the small sieving primes and the buckets of the large
+ *                  ones are set up once, then carried from one segment to
+ *                  the next.
+ *
+ * @range: Range
+ * @segs:  Segments to sieve
+ * @out:   Where to store the segments, contiguously, or NULL to only count
+ * @count: Where to add the number of primes found, or NULL
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int sieve_segments(sieve_range_t const *range, range_t const *segs,
+			  uint8_t *out, uint64_t *count)
+{
+	uint32_t (*offs)[8] = malloc(sizeof(*offs) * (range->nsmall + 1));
+	uint8_t *scratch = out ? NULL : malloc(SIEVE_SEGMENT), *seg;
+	sieve_buckets_t b;
+	uint64_t s, lo, p;
+	size_t active = 0, i, n;
+	int ret = -1;
+
+	if (offs && (out || scratch) && !buckets_init(&b, range, segs))
+	{
+		for (ret = 0, s = segs->begin; !ret && s < segs->end; s++)
+		{
+			seg = out ? out + (s - segs->begin) * SIEVE_SEGMENT :
+				scratch;
+			lo = range->start + s * SIEVE_SEGMENT_SPAN;
+			n = range->nbytes - s * SIEVE_SEGMENT;
+			n = n < SIEVE_SEGMENT ? n : SIEVE_SEGMENT;
+			memset(seg, 0xff, n);
+			for (; active < range->nsmall; active++)
+			{
+				p = range->primes[active];
+				if (p * p >= lo + 30 * n)
+					break;
+				wheel_offsets(p, lo, offs[active]);
+			}
+			for (i = 0; i < active; i++)
+				cross_off(seg, n, range->primes[i], offs[i]);
+			ret = sieve_large(&b, range, seg, s, n);
+			mask_ends(range, seg, s, n);
+			if (count)
+				*count += popcount(seg, n);
+		}
+		buckets_free(&b);
+	}
+	free(offs);
+	free(scratch);
+	return (ret);
+}
+
+/**
+ * count_segments - parallel_reduce body counting the primes of segments
+ *
+ * @segs: Segments
+ * @ctx:  Sieve job
+ * @acc:  Prime count of the thread
+ */
+static void count_segments(range_t const *segs, void *ctx, void *acc)
+{
+	sieve_job_t *job = ctx;
+
+	if (sieve_segments(job->range, segs, NULL, acc))
+		atomic_store(&job->failed, 1);
+}
+
+/**
+ * add_counts - parallel_reduce combiner of prime counts
+ *
+ * @acc:   Count to add to
+ * @other: Count to add
+ * @ctx:   Unused
+ */
+static void add_counts(void *acc, void const *other, void *ctx)
+{
+	(void)ctx;
+	*(uint64_t *)acc += *(uint64_t const *)other;
+}
+
+/**
+ * sieve_count - Counts the primes of a range, sieving its segments in
+ *               parallel on the shared pool
+ *
+ * @lo:    First number
+ * @hi:    End of the range, excluded; capped to SIEVE_RANGE_MAX
+ * @count: Where to store the number of primes
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+int sieve_count(uint64_t lo, uint64_t hi, uint64_t *count)
+{
+	sieve_range_t range;
+	sieve_job_t job = {0};
+	range_t segs;
+	int i;
+
+	*count = 0;
+	if (range_init(&range, lo, hi))
+		return (-1);
+	job.range = &range;
+	segs.begin = 0;
+	segs.end = (range.nbytes + SIEVE_SEGMENT - 1) / SIEVE_SEGMENT;
+	if (parallel_reduce(segs, 0, count_segments, add_counts, &job, count,
+			    sizeof(*count)) || atomic_load(&job.failed))
+		return (*count = 0, -1);
+	for (i = 0; i < 3; i++)
+		*count += wheel_primes[i] >= range.lo &&
+			wheel_primes[i] < range.hi;
+	return (0);
+}
+
+/**
+ * fill_segments - parallel_for body sieving segments into a window
+ *
+ * @segs: Segments
+ * @ctx:  Sieve job
+ */
+static void fill_segments(range_t const *segs, void *ctx)
+{
+	sieve_job_t *job = ctx;
+	uint8_t *out = job->window + (segs->begin - job->first) * SIEVE_SEGMENT;
+
+	if (sieve_segments(job->range, segs, out, NULL))
+		atomic_store(&job->failed, 1);
+}
+
+/**
+ * window_fill - Sieves the window following the current one
+ *
+ * @iter: Iterator
+ *
+ * Return: 1 on success, 0 once the range is exhausted, -1 on failure
+ */
+static int window_fill(sieve_iter_t *iter)
+{
+	uint64_t nsegs = (iter->range.nbytes + SIEVE_SEGMENT - 1) /
+		SIEVE_SEGMENT;
+	sieve_job_t job = {0};
+	range_t segs;
+
+	segs.begin = iter->first + iter->count;
+	if (segs.begin >= nsegs)
+		return (0);
+	segs.end = nsegs - segs.begin < iter->cap ? nsegs :
+		segs.begin + iter->cap;
+	job.range = &iter->range;
+	job.window = iter->window;
+	job.first = segs.begin;
+	parallel_for(segs, SIEVE_WINDOW_PER_CORE, fill_segments, &job);
+	if (atomic_load(&job.failed))
+		return (-1);
+	iter->first = segs.begin;
+	iter->count = segs.end - segs.begin;
+	iter->bytes = iter->range.nbytes - segs.begin * SIEVE_SEGMENT;
+	iter->bytes = iter->bytes < iter->count * SIEVE_SEGMENT ? iter->bytes :
+		iter->count * SIEVE_SEGMENT;
+	iter->pos = 0;
+	return (1);
+}
+
+/**
+ * sieve_iter_init - Starts the enumeration of the primes of a range
+ *
+ * @iter: Iterator to set up, to be released with sieve_iter_destroy
+ * @lo:   First number
+ * @hi:   End of the range, excluded; capped to SIEVE_RANGE_MAX
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+int sieve_iter_init(sieve_iter_t *iter, uint64_t lo, uint64_t hi)
+{
+	uint64_t nsegs;
+
+	memset(iter, 0, sizeof(*iter));
+	if (range_init(&iter->range, lo, hi))
+		return (-1);
+	nsegs = (iter->range.nbytes + SIEVE_SEGMENT - 1) / SIEVE_SEGMENT;
+	iter->cap = (size_t)topology_get()->allowed_cores *
+		SIEVE_WINDOW_PER_CORE;
+	iter->cap = nsegs < iter->cap ? nsegs : iter->cap;
+	if (iter->cap && !(iter->window = malloc(iter->cap * SIEVE_SEGMENT)))
+		return (-1);
+	return (0);
+}
+
+/**
+ * sieve_iter_next - Reads the next prime of a range, in ascending order
+ *
+ * @iter:  Iterator
+ * @prime: Where to store the prime
+ *
+ * Return: 1 if a prime was read, 0 at the end of the range, -1 on failure
+ */
+int sieve_iter_next(sieve_iter_t *iter, uint64_t *prime)
+{
+	uint64_t p;
+	int ret;
+
+	while (iter->small < 3)
+	{
+		p = wheel_primes[iter->small++];
+		if (p >= iter->range.lo && p < iter->range.hi)
+			return (*prime = p, 1);
+	}
+	while (!iter->bits)
+	{
+		if (iter->pos == iter->bytes && (ret = window_fill(iter)) < 1)
+			return (ret);
+		iter->number = iter->range.start +
+			30 * (iter->first * SIEVE_SEGMENT + iter->pos);
+		iter->bits = iter->window[iter->pos++];
+	}
+	*prime = iter->number + wheel[__builtin_ctz(iter->bits)];
+	iter->bits &= iter->bits - 1;
+	return (1);
+}
+
+/**
+ * sieve_iter_destroy - Releases an iterator
+ *
+ * @iter: Iterator
+ */
+void sieve_iter_destroy(sieve_iter_t *iter)
+{
+	free(iter->window);
+	iter->window = NULL;
+	iter->cap = 0;
+}
@@ -0,0 +1,244 @@
+#include "sieve.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * struct sieve_job_s - Segmented sieve of a range, shared by its workers
+ *
+ * @lo:     First number of the range, multiple of SIEVE_BLOCK_SPAN
+ * @blocks: Number of blocks in the range
+ * @next:   Next block to claim
+ * @base:   Odd base primes up to the square root of the range end
+ * @nbase:  Number of base primes
+ * @out:    Primes found in each block
+ * @nout:   Number of primes found in each block
+ */
+typedef struct sieve_job_s
+{
+	uint64_t lo;
+	size_t blocks;
+	atomic_size_t next;
+	uint32_t const *base;
+	size_t nbase;
+	uint32_t **out;
+	size_t *nout;
+} sieve_job_t;
+
+static pthread_mutex_t sieve_lock = PTHREAD_MUTEX_INITIALIZER;
+static prime_table_t empty_table;
+static prime_table_t *_Atomic sieve_table = &empty_table;
+
+/**
+ * sieve_block - Sieves one block of a job; the primes found are copied to a
+ *               buffer of their exact count, as the buffers of every block
+ *               stay alive until the job is merged
+ *
+ * @job:   Sieve job
+ * @b:     Index of the block in the job
+ * @flags: Scratch buffer of SIEVE_BLOCK bytes
+ */
+static void sieve_block(sieve_job_t *job, size_t b, uint8_t *flags)
+{
+	uint64_t lo = job->lo + b * SIEVE_BLOCK_SPAN;
+	uint64_t hi = lo + SIEVE_BLOCK_SPAN, p, m, j;
+	size_t i, n = 0;
+
+	memset(flags, 1, SIEVE_BLOCK);
+	for (i = 0; i < job->nbase &&
+		     (uint64_t)job->base[i] * job->base[i] < hi; i++)
+	{
+		p = job->base[i];
+		m = (lo + p - 1) / p * p;
+		if (m < p * p)
+			m = p * p;
+		if (!(m & 1))
+			m += p;
+		for (j = (m - lo) / 2; j < SIEVE_BLOCK; j += p)
+			flags[j] = 0;
+	}
+	if (lo == 0)
+		flags[0] = 0; /* 1 is not prime */
+	for (j = 0; j < SIEVE_BLOCK; j++)
+		n += flags[j];
+	n += lo == 0;
+	job->out[b] = malloc(sizeof(uint32_t) * (n ? n : 1));
+	if (!job->out[b])
+		return;
+	n = 0;
+	if (lo == 0)
+		job->out[b][n++] = 2;
+	for (j = 0; j < SIEVE_BLOCK; j++)
+		if (flags[j])
+			job->out[b][n++] = (uint32_t)(lo + 2 * j + 1);
+	job->nout[b] = n;
+}
+
+/**
+ * sieve_worker - Claims and sieves blocks until the job is done
+ *
+ * @arg: Pointer to the sieve job
+ *
+ * Return: NULL
+ */
+static void *sieve_worker(void *arg)
+{
+	sieve_job_t *job = arg;
+	uint8_t flags[SIEVE_BLOCK];
+	size_t b;
+
+	while ((b = atomic_fetch_add(&job->next, 1)) < job->blocks)
+		sieve_block(job, b, flags);
+	return (NULL);
+}
+
+/**
+ * base_primes - Lists the odd primes up to a small bound (simple sieve)
+ *
+ * @bound: Inclusive upper bound, at most 2^16
+ * @count: Where to store the number of primes
+ *
+ * Return: Malloc'd array of primes, or NULL
+ */
+static uint32_t *base_primes(uint32_t bound, size_t *count)
+{
+	uint8_t *composite = calloc(bound + 1, 1);
+	uint32_t *primes = malloc(sizeof(uint32_t) * (bound / 2 + 1)), p, m;
+
+	*count = 0;
+	if (!composite || !primes)
+	{
+		free(composite);
+		free(primes);
+		return (NULL);
+	}
+	for (p = 3; p <= bound; p += 2)
+		if (!composite[p])
+		{
+			primes[(*count)++] = p;
+			for (m = p * p; m <= bound; m += 2 * p)
+				composite[m] = 1;
+		}
+	free(composite);
+	return (primes);
+}
+
+/**
+ * sieve_range - Sieves [lo, hi) in parallel and extends a table with the
+ *               primes found; the new table is sized once every block has
+ *               been counted
+ *
+ * @old: Table to extend, whose limit is lo
+ * @hi:  End of the range, multiple of SIEVE_BLOCK_SPAN
+ *
+ * Return: Malloc'd table listing every prime lower than @hi, or NULL on
+ * allocation failure
+ */
+static prime_table_t *sieve_range(prime_table_t *old, uint64_t hi)
+{
+	pthread_t threads[SIEVE_MAX_THREADS];
+	long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	sieve_job_t job = {0};
+	prime_table_t *table = NULL;
+	uint32_t root = 1, *base;
+	size_t b, t, count = old->count;
+
+	while ((uint64_t)root * root < hi)
+		root++;
+	base = base_primes(root, &job.nbase);
+	job.lo = old->limit;
+	job.blocks = (hi - old->limit) / SIEVE_BLOCK_SPAN;
+	job.base = base;
+	job.out = calloc(job.blocks, sizeof(*job.out));
+	job.nout = calloc(job.blocks, sizeof(*job.nout));
+	if (!base || !job.out || !job.nout)
+		job.blocks = 0;
+	nthreads = nthreads < 1 ? 1 : nthreads;
+	nthreads = nthreads > SIEVE_MAX_THREADS ? SIEVE_MAX_THREADS : nthreads;
+	for (t = 0; t + 1 < (size_t)nthreads && t + 1 < job.blocks; t++)
+		if (pthread_create(&threads[t], NULL, sieve_worker, &job))
+			break;
+	sieve_worker(&job);
+	while (t--)
+		pthread_join(threads[t], NULL);
+	for (b = 0; b < job.blocks && job.out[b]; b++)
+		count += job.nout[b];
+	if (job.blocks && b == job.blocks)
+		table = malloc(sizeof(*table));
+	if (table)
+		table->primes = malloc(sizeof(uint32_t) * (count ? count : 1));
+	if (table && !table->primes)
+		free(table), table = NULL;
+	if (table)
+	{
+		table->count = old->count;
+		table->limit = hi;
+		table->retired = old;
+		if (old->count)
+			memcpy(table->primes, old->primes,
+			       sizeof(uint32_t) * old->count);
+	}
+	for (b = 0; b < job.blocks; b++)
+	{
+		if (table)
+		{
+			memcpy(table->primes + table->count, job.out[b],
+			       sizeof(uint32_t) * job.nout[b]);
+			table->count += job.nout[b];
+		}
+		free(job.out[b]);
+	}
+	free(job.out), free(job.nout), free(base);
+	return (table);
+}
+
+/**
+ * sieve_primes - Returns a snapshot of the shared prime table covering at
+ *                least every prime lower than a bound. The table is built
+ *                lazily and extended on demand; snapshots are read-only and
+ *                stay valid until the process exits.
+ *
+ * @limit: Bound, capped to SIEVE_MAX_LIMIT
+ *
+ * Return: Pointer to the prime table, whose limit may be lower than @limit
+ * only if memory could not be allocated
+ */
+prime_table_t const *sieve_primes(uint64_t limit)
+{
+	prime_table_t *old, *table;
+	uint64_t hi;
+
+	old = atomic_load_explicit(&sieve_table, memory_order_acquire);
+	limit = limit > SIEVE_MAX_LIMIT ? SIEVE_MAX_LIMIT : limit;
+	if (old->limit >= limit)
+		return (old);
+	pthread_mutex_lock(&sieve_lock);
+	old = atomic_load_explicit(&sieve_table, memory_order_relaxed);
+	hi = old->limit * 2 > limit ? old->limit * 2 : limit;
+	hi = (hi + SIEVE_BLOCK_SPAN - 1) / SIEVE_BLOCK_SPAN * SIEVE_BLOCK_SPAN;
+	hi = hi > SIEVE_MAX_LIMIT ? SIEVE_MAX_LIMIT : hi;
+	table = old->limit >= limit ? NULL : sieve_range(old, hi);
+	if (table)
+		atomic_store_explicit(&sieve_table, table,
+				      memory_order_release);
+	pthread_mutex_unlock(&sieve_lock);
+	return (atomic_load_explicit(&sieve_table, memory_order_acquire));
+}
+
+/**
+ * sieve_cleanup - Frees every snapshot of the shared prime table at exit
+ */
+__attribute__((destructor)) static void sieve_cleanup(void)
+{
+	prime_table_t *table = atomic_load(&sieve_table), *tmp;
+
+	while (table && table != &empty_table)
+	{
+		tmp = table->retired;
+		free(table->primes);
+		free(table);
+		table = tmp;
+	}
+}
@@ -0,0 +1,106 @@
+#ifndef SIEVE_H
+#define SIEVE_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint32_t, uint64_t */
+
+/* Bytes sieved at once by a worker; one byte per odd number */
+#define SIEVE_BLOCK 32768
+/* Numbers covered by one block */
+#define SIEVE_BLOCK_SPAN (2 * (uint64_t)SIEVE_BLOCK)
+/* Primes are stored on 32 bits */
+#define SIEVE_MAX_LIMIT (1ULL << 32)
+#define SIEVE_MAX_THREADS 16
+/* Bytes of a range sieve segment, sized for the L1 data cache */
+#define SIEVE_SEGMENT 32768
+/* Numbers covered by a segment, 30 per byte */
+#define SIEVE_SEGMENT_SPAN (30 * (uint64_t)SIEVE_SEGMENT)
+/* Segments sieved per core at once by a range iterator */
+#define SIEVE_WINDOW_PER_CORE 32
+/*
+ * End bound of the ranges, leaving room for the multiples computed past it;
+ * sieving up to it lists every prime below 2^32 (see sieve_bench check)
+ */
+#define SIEVE_RANGE_MAX (UINT64_MAX - (1ULL << 33))
+
+/**
+ * struct prime_table_s - Immutable snapshot of the shared prime sieve
+ *
+ * @limit:   Every prime lower than limit is listed
+ * @count:   Number of primes listed
+ * @primes:  Primes, in ascending order
+ * @retired: Previous, smaller snapshot; kept alive until exit since
+ *           readers may still hold it
+ */
+typedef struct prime_table_s
+{
+	uint64_t limit;
+	size_t count;
+	uint32_t *primes;
+	struct prime_table_s *retired;
+} prime_table_t;
+
+/**
+ * struct sieve_range_s - Range to sieve with the wheel-30 segmented sieve
+ *
+ * @lo:      First number of the range
+ * @hi:      End of the range, excluded
+ * @start:   lo rounded down to a multiple of 30, number of the first byte
+ * @nbytes:  Number of bytes covering the range
+ * @primes:  Sieving primes, from 7 up to the square root of hi
+ * @nprimes: Number of sieving primes
+ * @nsmall:  Number of sieving primes lower than SIEVE_SEGMENT, crossed off
+ *           with strided loops; the larger ones, hitting a segment a few
+ *           times at most, are filed in buckets by segment
+ */
+typedef struct sieve_range_s
+{
+	uint64_t lo;
+	uint64_t hi;
+	uint64_t start;
+	uint64_t nbytes;
+	uint32_t const *primes;
+	size_t nprimes;
+	size_t nsmall;
+} sieve_range_t;
+
+/**
+ * struct sieve_iter_s - Streaming enumeration of the primes of a range:
+ *                       windows of segments are sieved in parallel, then
+ *                       read in ascending order
+ *
+ * @range:  Range
+ * @window: Sieved bytes of the current window
+ * @cap:    Capacity of the window, in segments
+ * @first:  First segment of the window
+ * @count:  Number of segments in the window
+ * @bytes:  Number of bytes in the window
+ * @pos:    Next byte of the window to read
+ * @bits:   Unread primes of the current byte
+ * @number: Number of the current byte
+ * @small:  Number of wheel primes (2, 3, 5) already considered
+ */
+typedef struct sieve_iter_s
+{
+	sieve_range_t range;
+	uint8_t *window;
+	size_t cap;
+	uint64_t first;
+	uint64_t count;
+	size_t bytes;
+	size_t pos;
+	unsigned int bits;
+	uint64_t number;
+	int small;
+} sieve_iter_t;
+
+/* prime_sieve.c */
+prime_table_t const	*sieve_primes(uint64_t limit);
+
+/* prime_range.c */
+int	sieve_count(uint64_t lo, uint64_t hi, uint64_t *count);
+int	sieve_iter_init(sieve_iter_t *iter, uint64_t lo, uint64_t hi);
+int	sieve_iter_next(sieve_iter_t *iter, uint64_t *prime);
+void	sieve_iter_destroy(sieve_iter_t *iter);
+
+#endif /* SIEVE_H */
@@ -0,0 +1,226 @@
+#include "multithreading.h"
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <time.h>
+
+/**
+ * struct task_timer_s - Timeouts of the running tasks, enforced by a single
+ *                       timer thread
+ *
+ * @lock:     Guards the other members
+ * @wake:     Signalled when an earlier expiry is armed
+ * @thread:   Timer thread
+ * @heap:     Running tasks with a timeout, min-heap of expiries; each
+ *            task keeps its index in timer_slot
+ * @expiries: Expiry of each task of the heap, on the task_clock_ns clock
+ * @count:    Number of armed timeouts
+ * @cap:      Capacity of the heap
+ */
+typedef struct task_timer_s
+{
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_t thread;
+	task_t **heap;
+	uint64_t *expiries;
+	size_t count;
+	size_t cap;
+} task_timer_t;
+
+static task_timer_t timer;
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+static int timer_started;
+
+/**
+ * cancel_task - Requests the cancellation of a task: a pending task is
+ *               cancelled right away and never runs, a started task is
+ *               cancelled once its entry notices, through cancel_requested;
+ *               a coroutine parked in coro_wait_fd is resumed to notice
+ *
+ * @task: Task
+ *
+ * Return: 1 if the request was registered, 0 if the task already completed
+ */
+int cancel_task(task_t *task)
+{
+	int registered;
+
+	pthread_mutex_lock(&task->lock);
+	registered = task->status == PENDING || task->status == STARTED;
+	if (registered)
+		atomic_store(&task->cancelled, 1);
+	if (registered && task->wake_fd >= 0)
+		eventfd_write(task->wake_fd, 1);
+	if (task->status == PENDING)
+		task->status = CANCELLED;
+	pthread_mutex_unlock(&task->lock);
+	return (registered);
+}
+
+/**
+ * heap_swap - Swaps two timeouts of the timer heap
+ *
+ * @i: First index
+ * @j: Second index
+ */
+static void heap_swap(size_t i, size_t j)
+{
+	task_t *task = timer.heap[i];
+	uint64_t expiry = timer.expiries[i];
+
+	timer.heap[i] = timer.heap[j];
+	timer.expiries[i] = timer.expiries[j];
+	timer.heap[j] = task;
+	timer.expiries[j] = expiry;
+	timer.heap[i]->timer_slot = i + 1;
+	timer.heap[j]->timer_slot = j + 1;
+}
+
+/**
+ * heap_fix - Restores the heap order around a timeout whose expiry changed
+ *
+ * @i: Index of the timeout
+ */
+static void heap_fix(size_t i)
+{
+	size_t child;
+
+	for (; i && timer.expiries[(i - 1) / 2] > timer.expiries[i];
+	     i = (i - 1) / 2)
+		heap_swap(i, (i - 1) / 2);
+	for (; (child = 2 * i + 1) < timer.count; i = child)
+	{
+		if (child + 1 < timer.count &&
+		    timer.expiries[child + 1] < timer.expiries[child])
+			child++;
+		if (timer.expiries[child] >= timer.expiries[i])
+			break;
+		heap_swap(i, child);
+	}
+}
+
+/**
+ * heap_remove - Removes a timeout from the timer heap
+ *
+ * @i: Index of the timeout
+ */
+static void heap_remove(size_t i)
+{
+	timer.heap[i]->timer_slot = 0;
+	if (i != --timer.count)
+	{
+		timer.heap[i] = timer.heap[timer.count];
+		timer.expiries[i] = timer.expiries[timer.count];
+		timer.heap[i]->timer_slot = i + 1;
+		heap_fix(i);
+	}
+}
+
+/**
+ * timer_thread - Cancels the running tasks whose timeout expired
+ *
+ * @arg: Unused
+ *
+ * Return: Never returns
+ */
+static void *timer_thread(void *arg)
+{
+	struct timespec until;
+	uint64_t now;
+
+	(void)arg;
+	pthread_mutex_lock(&timer.lock);
+	for (;;)
+	{
+		now = task_clock_ns();
+		while (timer.count && timer.expiries[0] <= now)
+		{
+			atomic_store(&timer.heap[0]->cancelled, 1);
+			heap_remove(0);
+		}
+		if (!timer.count)
+		{
+			pthread_cond_wait(&timer.wake, &timer.lock);
+			continue;
+		}
+		until.tv_sec = timer.expiries[0] / 1000000000;
+		until.tv_nsec = timer.expiries[0] % 1000000000;
+		pthread_cond_timedwait(&timer.wake, &timer.lock, &until);
+	}
+	return (NULL);
+}
+
+/**
+ * timer_init - Starts the timer thread, once; its condition variable waits
+ *              on the monotonic clock, like task_clock_ns
+ */
+static void timer_init(void)
+{
+	pthread_condattr_t attr;
+
+	pthread_mutex_init(&timer.lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&timer.wake, &attr);
+	pthread_condattr_destroy(&attr);
+	if (!pthread_create(&timer.thread, NULL, timer_thread, NULL))
+	{
+		pthread_detach(timer.thread);
+		timer_started = 1;
+	}
+}
+
+/**
+ * task_timer_arm - Starts the timeout of a task about to run
+ *
+ * @task: Task, with a nonzero timeout_ns
+ *
+ * Return: 0 on success, -1 if the timeout cannot be enforced
+ */
+int task_timer_arm(task_t *task)
+{
+	size_t cap;
+	void *tmp;
+
+	pthread_once(&timer_once, timer_init);
+	if (!timer_started)
+		return (-1);
+	pthread_mutex_lock(&timer.lock);
+	if (timer.count == timer.cap)
+	{
+		cap = timer.cap ? timer.cap * 2 : 16;
+		tmp = realloc(timer.heap, sizeof(*timer.heap) * cap);
+		if (tmp)
+			timer.heap = tmp;
+		tmp = tmp ? realloc(timer.expiries,
+				    sizeof(*timer.expiries) * cap) : NULL;
+		if (tmp)
+			timer.expiries = tmp, timer.cap = cap;
+		if (!tmp)
+			return (pthread_mutex_unlock(&timer.lock), -1);
+	}
+	timer.heap[timer.count] = task;
+	timer.expiries[timer.count] = task_clock_ns() + task->timeout_ns;
+	task->timer_slot = timer.count + 1;
+	heap_fix(timer.count++);
+	if (timer.heap[0] == task)
+		pthread_cond_signal(&timer.wake);
+	pthread_mutex_unlock(&timer.lock);
+	return (0);
+}
+
+/**
+ * task_timer_disarm - Stops the timeout of a task that finished running, so
+ *                     that the timer thread no longer references it; the
+ *                     task knows its place in the heap, so this is
+ *                     O(log n)
+ *
+ * @task: Task whose timeout was armed
+ */
+void task_timer_disarm(task_t *task)
+{
+	pthread_mutex_lock(&timer.lock);
+	if (task->timer_slot)
+		heap_remove(task->timer_slot - 1);
+	pthread_mutex_unlock(&timer.lock);
+}
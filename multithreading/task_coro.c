@@ -0,0 +1,516 @@
+#include "multithreading.h"
+#include "topology.h"
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#define CORO_EVENTS 256
+/* Poll slice of coro_wait_fd outside of a coroutine, to notice cancels */
+#define CORO_POLL_MS 10
+
+/**
+ * struct coro_s - Task running on its own stack
+ *
+ * @ctx:       Saved context while suspended
+ * @task:      Task
+ * @stack:     Stack, from the stack pool
+ * @next:      Next coroutine in the ready queue
+ * @expiry:    End of the task timeout on the task_clock_ns clock, or 0
+ * @parked:    Whether the coroutine is parked in the reactor
+ * @wait_prev: Previous coroutine parked in the reactor
+ * @wait_next: Next coroutine parked in the reactor
+ */
+typedef struct coro_s
+{
+	ucontext_t ctx;
+	task_t *task;
+	void *stack;
+	struct coro_s *next;
+	uint64_t expiry;
+	int parked;
+	struct coro_s *wait_prev;
+	struct coro_s *wait_next;
+} coro_t;
+
+/**
+ * struct coro_worker_s - Per-thread coroutine scheduler and epoll reactor
+ *
+ * @main:    Context of the worker loop
+ * @current: Running coroutine
+ * @head:    Front of the ready queue
+ * @tail:    Back of the ready queue
+ * @epfd:    Epoll instance of the coroutines waiting on fds
+ * @wakefd:  Eventfd in @epfd, signalled by cancel_task to resume a parked
+ *           coroutine
+ * @live:    Coroutines started and not finished
+ * @waiting: Coroutines parked in the reactor
+ * @parked:  Coroutines parked in the reactor, in a doubly-linked list
+ * @stats:   Metrics of the thread
+ */
+typedef struct coro_worker_s
+{
+	ucontext_t main;
+	coro_t *current;
+	coro_t *head;
+	coro_t *tail;
+	int epfd;
+	int wakefd;
+	size_t live;
+	size_t waiting;
+	coro_t *parked;
+	task_worker_stats_t *stats;
+} coro_worker_t;
+
+/**
+ * struct stack_pool_s - Stacks of finished coroutines, kept for reuse
+ *
+ * @lock:   Pool mutex
+ * @stacks: Free stacks
+ * @count:  Number of free stacks
+ */
+typedef struct stack_pool_s
+{
+	pthread_mutex_t lock;
+	void *stacks[CORO_POOL_MAX];
+	size_t count;
+} stack_pool_t;
+
+static stack_pool_t pool = {PTHREAD_MUTEX_INITIALIZER, {NULL}, 0};
+static __thread coro_worker_t *tls_worker;
+
+/**
+ * stack_get - Takes a stack from the pool, or maps a new one with a guard
+ *             page below it to catch overflows
+ *
+ * Return: Lowest usable address of the stack, or NULL
+ */
+static void *stack_get(void)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	void *stack = NULL;
+
+	pthread_mutex_lock(&pool.lock);
+	if (pool.count)
+		stack = pool.stacks[--pool.count];
+	pthread_mutex_unlock(&pool.lock);
+	if (stack)
+		return (stack);
+	stack = mmap(NULL, CORO_STACK_SIZE + page, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+	if (stack == MAP_FAILED)
+		return (NULL);
+	mprotect(stack, page, PROT_NONE);
+	return ((char *)stack + page);
+}
+
+/**
+ * stack_put - Returns a stack to the pool, unmapping it if the pool is full
+ *
+ * @stack: Stack, as returned by stack_get
+ */
+static void stack_put(void *stack)
+{
+	long page = sysconf(_SC_PAGESIZE);
+
+	pthread_mutex_lock(&pool.lock);
+	if (pool.count < CORO_POOL_MAX)
+	{
+		pool.stacks[pool.count++] = stack;
+		stack = NULL;
+	}
+	pthread_mutex_unlock(&pool.lock);
+	if (stack)
+		munmap((char *)stack - page, CORO_STACK_SIZE + page);
+}
+
+/**
+ * ready_push - Queues a coroutine to be resumed by its worker
+ *
+ * @worker: Worker
+ * @coro:   Coroutine
+ */
+static void ready_push(coro_worker_t *worker, coro_t *coro)
+{
+	coro->next = NULL;
+	if (worker->tail)
+		worker->tail->next = coro;
+	else
+		worker->head = coro;
+	worker->tail = coro;
+}
+
+/**
+ * park - Parks a coroutine in the reactor until its fd is ready, or its
+ *        task is cancelled or times out
+ *
+ * @worker: Worker
+ * @coro:   Running coroutine
+ */
+static void park(coro_worker_t *worker, coro_t *coro)
+{
+	coro->parked = 1;
+	coro->wait_prev = NULL;
+	coro->wait_next = worker->parked;
+	if (worker->parked)
+		worker->parked->wait_prev = coro;
+	worker->parked = coro;
+	worker->waiting++;
+}
+
+/**
+ * unpark - Moves a parked coroutine to the ready queue; does nothing if it
+ *          was already moved
+ *
+ * @worker: Worker
+ * @coro:   Coroutine
+ */
+static void unpark(coro_worker_t *worker, coro_t *coro)
+{
+	if (!coro->parked)
+		return;
+	coro->parked = 0;
+	if (coro->wait_prev)
+		coro->wait_prev->wait_next = coro->wait_next;
+	else
+		worker->parked = coro->wait_next;
+	if (coro->wait_next)
+		coro->wait_next->wait_prev = coro->wait_prev;
+	worker->waiting--;
+	ready_push(worker, coro);
+}
+
+/**
+ * coro_main - Entry of every coroutine: runs its task, then returns to the
+ *             worker loop through uc_link
+ */
+static void coro_main(void)
+{
+	coro_worker_t *worker = tls_worker;
+	coro_t *coro = worker->current;
+
+	coro->expiry = coro->task->timeout_ns ?
+		task_clock_ns() + coro->task->timeout_ns : 0;
+	run_task(coro->task, worker->stats, 0);
+}
+
+/**
+ * coro_spawn - Starts a claimed task as a coroutine
+ *
+ * @worker: Worker
+ * @task:   Task
+ *
+ * Return: 0 on success, -1 if no stack could be allocated
+ */
+static int coro_spawn(coro_worker_t *worker, task_t *task)
+{
+	coro_t *coro = malloc(sizeof(*coro));
+
+	if (!coro || !(coro->stack = stack_get()))
+		return (free(coro), -1);
+	getcontext(&coro->ctx);
+	coro->ctx.uc_stack.ss_sp = coro->stack;
+	coro->ctx.uc_stack.ss_size = CORO_STACK_SIZE;
+	coro->ctx.uc_link = &worker->main;
+	makecontext(&coro->ctx, coro_main, 0);
+	coro->task = task;
+	coro->parked = 0;
+	worker->live++;
+	ready_push(worker, coro);
+	return (0);
+}
+
+/**
+ * coro_resume - Runs a coroutine until it suspends or finishes
+ *
+ * @worker: Worker
+ * @coro:   Ready coroutine
+ */
+static void coro_resume(coro_worker_t *worker, coro_t *coro)
+{
+	int finished;
+
+	worker->current = coro;
+	swapcontext(&worker->main, &coro->ctx);
+	/* A suspended coroutine clears current before switching back */
+	finished = worker->current != NULL;
+	worker->current = NULL;
+	cancel_current = NULL;
+	if (!finished)
+		return;
+	worker->live--;
+	stack_put(coro->stack);
+	free(coro);
+}
+
+/**
+ * coro_suspend - Switches from the running coroutine back to its worker
+ *
+ * @worker: Worker
+ */
+static void coro_suspend(coro_worker_t *worker)
+{
+	coro_t *coro = worker->current;
+	cancel_token_t *token = cancel_current;
+
+	worker->current = NULL;
+	swapcontext(&coro->ctx, &worker->main);
+	cancel_current = token;
+}
+
+/**
+ * coro_yield - Lets the other ready coroutines of the worker run; does
+ *              nothing outside of a coroutine
+ */
+void coro_yield(void)
+{
+	coro_worker_t *worker = tls_worker;
+
+	if (!worker || !worker->current)
+		return;
+	ready_push(worker, worker->current);
+	coro_suspend(worker);
+}
+
+/**
+ * wait_poll - Blocks the thread in poll until a file descriptor is ready;
+ *             within a task, polls in slices to notice a cancellation
+ *
+ * @fd:     File descriptor
+ * @events: Events to wait for
+ *
+ * Return: 0 once ready, -1 on error or if the running task is cancelled
+ */
+static int wait_poll(int fd, uint32_t events)
+{
+	struct pollfd pfd;
+	int ready;
+
+	pfd.fd = fd;
+	pfd.events = (short)events;
+	while ((ready = poll(&pfd, 1, cancel_current ? CORO_POLL_MS : -1)) <= 0)
+		if ((ready < 0 && errno != EINTR) || cancel_requested())
+			return (-1);
+	return (0);
+}
+
+/**
+ * coro_wait_fd - Waits until a file descriptor is ready. In a coroutine
+ *                task, the coroutine is parked in its worker's epoll
+ *                reactor and the worker runs other tasks meanwhile;
+ *                elsewhere, the thread blocks in poll. Several coroutines
+ *                may wait on the same fd: as epoll takes an fd once, the
+ *                later ones wait on a duplicate of it.
+ *
+ * @fd:     File descriptor
+ * @events: Events to wait for (EPOLLIN, EPOLLOUT)
+ *
+ * Return: 0 once ready, -1 on error or if the running task is cancelled,
+ * or times out, before the fd is ready
+ */
+int coro_wait_fd(int fd, uint32_t events)
+{
+	coro_worker_t *worker = tls_worker;
+	struct epoll_event ev;
+	coro_t *coro;
+	int cancelled, wfd = fd;
+
+	if (cancel_requested())
+		return (-1);
+	if (!worker || !worker->current)
+		return (wait_poll(fd, events));
+	coro = worker->current;
+	ev.events = events | EPOLLONESHOT;
+	ev.data.ptr = coro;
+	if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, fd, &ev))
+	{
+		if (errno == EPERM) /* Regular files are always ready */
+			return (0);
+		if (errno != EEXIST || (wfd = dup(fd)) < 0)
+			return (-1);
+		if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, wfd, &ev))
+			return (close(wfd), -1);
+	}
+	/* cancel_task sees either the wake fd, or its request is seen here */
+	pthread_mutex_lock(&coro->task->lock);
+	coro->task->wake_fd = worker->wakefd;
+	cancelled = atomic_load(&coro->task->cancelled);
+	pthread_mutex_unlock(&coro->task->lock);
+	if (!cancelled)
+	{
+		park(worker, coro);
+		coro_suspend(worker);
+	}
+	pthread_mutex_lock(&coro->task->lock);
+	coro->task->wake_fd = -1;
+	pthread_mutex_unlock(&coro->task->lock);
+	epoll_ctl(worker->epfd, EPOLL_CTL_DEL, wfd, NULL);
+	if (wfd != fd)
+		close(wfd);
+	return (cancel_requested() ? -1 : 0);
+}
+
+/**
+ * reactor_timeout - Bounds a reactor wait by the earliest timeout of the
+ *                   parked coroutines
+ *
+ * @worker: Worker
+ * @block:  Whether to wait at all
+ *
+ * Return: epoll_wait timeout, in milliseconds
+ */
+static int reactor_timeout(coro_worker_t const *worker, int block)
+{
+	uint64_t next = 0, now;
+	coro_t *coro;
+
+	if (!block)
+		return (0);
+	for (coro = worker->parked; coro; coro = coro->wait_next)
+		if (coro->expiry && (!next || coro->expiry < next))
+			next = coro->expiry;
+	if (!next)
+		return (-1);
+	now = task_clock_ns();
+	if (next <= now)
+		return (0);
+	next = (next - now + 999999) / 1000000;
+	return (next > INT_MAX ? INT_MAX : (int)next);
+}
+
+/**
+ * reactor_poll - Moves the coroutines whose fds are ready, or whose task
+ *                was cancelled or timed out, to the ready queue
+ *
+ * @worker: Worker
+ * @block:  Whether to wait for one of them
+ */
+static void reactor_poll(coro_worker_t *worker, int block)
+{
+	struct epoll_event events[CORO_EVENTS];
+	coro_t *coro, *next;
+	eventfd_t wakes;
+	uint64_t now;
+	int n, i;
+
+	n = epoll_wait(worker->epfd, events, CORO_EVENTS,
+		       reactor_timeout(worker, block));
+	for (i = 0; i < n; i++)
+		if (events[i].data.ptr)
+			unpark(worker, events[i].data.ptr);
+		else
+			eventfd_read(worker->wakefd, &wakes);
+	now = task_clock_ns();
+	for (coro = worker->parked; coro; coro = next)
+	{
+		next = coro->wait_next;
+		/* The timer thread may not have fired yet */
+		if (coro->expiry && coro->expiry <= now)
+			atomic_store(&coro->task->cancelled, 1);
+		if (atomic_load_explicit(&coro->task->cancelled,
+					 memory_order_relaxed))
+			unpark(worker, coro);
+	}
+}
+
+/**
+ * next_task - Claims the next pending task of a list
+ *
+ * @cursor: First node not yet considered by the worker, updated
+ *
+ * Return: Claimed task, or NULL once the list is exhausted
+ */
+static task_t *next_task(node_t **cursor)
+{
+	node_t *node;
+
+	for (node = *cursor; node; node = node->next)
+		if (claim_task(node->content))
+		{
+			*cursor = node->next;
+			return (node->content);
+		}
+	*cursor = NULL;
+	return (NULL);
+}
+
+/**
+ * exec_tasks_coro - Thread entry executing a list of tasks as coroutines:
+ *                   up to CORO_MAX_INFLIGHT tasks share the thread, and a
+ *                   task blocked in coro_wait_fd lets the others run; it
+ *                   is resumed early if cancelled or timed out
+ *
+ * @tasks: List of tasks
+ *
+ * Return: NULL
+ */
+void *exec_tasks_coro(list_t const *tasks)
+{
+	coro_worker_t worker = {0};
+	node_t *cursor = tasks ? tasks->head : NULL;
+	struct epoll_event ev;
+	task_t *task;
+	coro_t *coro;
+	int block;
+
+	worker.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (worker.epfd < 0)
+		return (NULL);
+	worker.wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (worker.wakefd < 0 ||
+	    epoll_ctl(worker.epfd, EPOLL_CTL_ADD, worker.wakefd, &ev))
+	{
+		if (worker.wakefd >= 0)
+			close(worker.wakefd);
+		close(worker.epfd);
+		return (NULL);
+	}
+	worker.stats = task_stats_worker();
+	tls_worker = &worker;
+	topology_pin_worker();
+	for (;;)
+	{
+		while (worker.live < CORO_MAX_INFLIGHT &&
+		       (task = next_task(&cursor)))
+			if (coro_spawn(&worker, task))
+			{
+				run_task(task, worker.stats, 0);
+				break;
+			}
+		while ((coro = worker.head))
+		{
+			worker.head = coro->next;
+			if (!worker.head)
+				worker.tail = NULL;
+			coro_resume(&worker, coro);
+		}
+		if (!worker.live && !cursor)
+			break;
+		block = worker.live >= CORO_MAX_INFLIGHT || !cursor;
+		if (worker.waiting)
+			reactor_poll(&worker, block);
+	}
+	tls_worker = NULL;
+	close(worker.wakefd);
+	close(worker.epfd);
+	return (NULL);
+}
+
+/**
+ * stack_pool_cleanup - Unmaps the pooled stacks at exit
+ */
+__attribute__((destructor)) static void stack_pool_cleanup(void)
+{
+	long page = sysconf(_SC_PAGESIZE);
+
+	while (pool.count)
+		munmap((char *)pool.stacks[--pool.count] - page,
+		       CORO_STACK_SIZE + page);
+}
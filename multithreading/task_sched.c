@@ -0,0 +1,298 @@
+#include "multithreading.h"
+#include "topology.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCHED_EMPTY UINT64_MAX
+
+/**
+ * struct sched_level_s - Ready tasks of one priority level, in a binary
+ *                        min-heap of urgency keys
+ *
+ * @top:   Creation time of the heap top, or SCHED_EMPTY; published for
+ *         lock-free peeks, with @top_deadline
+ * @top_deadline: Deadline of the heap top, or 0 for none
+ * @lock:  Level mutex, guarding the heap
+ * @heap:  Tasks
+ * @count: Number of tasks in the heap
+ * @cap:   Capacity of the heap
+ */
+typedef struct sched_level_s
+{
+	atomic_uint_fast64_t top;
+	atomic_uint_fast64_t top_deadline;
+	pthread_mutex_t lock;
+	task_t **heap;
+	size_t count;
+	size_t cap;
+} __attribute__((aligned(64))) sched_level_t;
+
+/**
+ * struct task_sched_s - Priority scheduler: one independently locked heap
+ *                       per level, so that workers serving different levels
+ *                       never contend
+ *
+ * @levels: Levels, most urgent first
+ */
+struct task_sched_s
+{
+	sched_level_t levels[TASK_PRIO_MAX];
+};
+
+/**
+ * task_key - Computes the urgency key of a task within its level: its
+ *            deadline, or for a task without one, its creation time plus
+ *            TASK_AGING_NS. Within a level, tasks run earliest deadline first
+ *            and plain tasks run in creation order.
+ *
+ * @task: Task
+ *
+ * Return: Key, lower is more urgent
+ */
+static uint64_t task_key(task_t const *task)
+{
+	return (task->deadline_ns ? task->deadline_ns :
+		task->enqueued_ns + TASK_AGING_NS);
+}
+
+/**
+ * level_publish - Publishes the creation time and deadline of a level's
+ *                 heap top
+ *
+ * @level: Locked level
+ */
+static void level_publish(sched_level_t *level)
+{
+	atomic_store_explicit(&level->top_deadline, level->count ?
+			      level->heap[0]->deadline_ns : 0,
+			      memory_order_relaxed);
+	atomic_store_explicit(&level->top, level->count ?
+			      level->heap[0]->enqueued_ns : SCHED_EMPTY,
+			      memory_order_release);
+}
+
+/**
+ * level_push - Adds a task to a level's heap
+ *
+ * @level: Locked level
+ * @task:  Task
+ *
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int level_push(sched_level_t *level, task_t *task)
+{
+	size_t i = level->count, parent, cap;
+	task_t **heap = level->heap;
+
+	if (level->count == level->cap)
+	{
+		cap = level->cap ? level->cap * 2 : 64;
+		heap = realloc(heap, sizeof(*heap) * cap);
+		if (!heap)
+			return (-1);
+		level->heap = heap;
+		level->cap = cap;
+	}
+	for (; i && task_key(heap[parent = (i - 1) / 2]) > task_key(task);
+	     i = parent)
+		heap[i] = heap[parent];
+	heap[i] = task;
+	level->count++;
+	level_publish(level);
+	return (0);
+}
+
+/**
+ * level_pop - Removes the most urgent task of a level's heap
+ *
+ * @level: Locked level
+ *
+ * Return: Task, or NULL if the heap is empty
+ */
+static task_t *level_pop(sched_level_t *level)
+{
+	task_t **heap = level->heap, *top, *last;
+	size_t i = 0, child;
+
+	if (!level->count)
+		return (NULL);
+	top = heap[0];
+	last = heap[--level->count];
+	for (; (child = 2 * i + 1) < level->count; i = child)
+	{
+		if (child + 1 < level->count &&
+		    task_key(heap[child + 1]) < task_key(heap[child]))
+			child++;
+		if (task_key(heap[child]) >= task_key(last))
+			break;
+		heap[i] = heap[child];
+	}
+	heap[i] = last;
+	level_publish(level);
+	return (top);
+}
+
+/**
+ * sched_pick - Chooses the level to serve from the published heap tops,
+ *              without locking. A top whose deadline passed goes first,
+ *              earliest deadline first. Otherwise a top is promoted by one
+ *              level per TASK_AGING_NS it waited, up to the most urgent one,
+ *              and the most urgent promoted level goes first; on a tie, the
+ *              level more urgent to begin with. A backlog of old bulk work
+ *              thus only ties with fresh urgent work, and yields to it.
+ *
+ * @sched: Scheduler
+ * @now:   Current time
+ *
+ * Return: Level index, or -1 if every level is empty
+ */
+static int sched_pick(task_sched_t *sched, uint64_t now)
+{
+	uint64_t enqueued, deadline, late = SCHED_EMPTY, aged;
+	uint64_t best = SCHED_EMPTY;
+	int l, late_pick = -1, pick = -1;
+	sched_level_t *level;
+
+	for (l = 0; l < TASK_PRIO_MAX; l++)
+	{
+		level = &sched->levels[l];
+		enqueued = atomic_load_explicit(&level->top,
+						memory_order_acquire);
+		if (enqueued == SCHED_EMPTY)
+			continue;
+		deadline = atomic_load_explicit(&level->top_deadline,
+						memory_order_relaxed);
+		if (deadline && deadline <= now && deadline < late)
+		{
+			late = deadline;
+			late_pick = l;
+		}
+		aged = enqueued < now ? (now - enqueued) / TASK_AGING_NS : 0;
+		aged = aged < (uint64_t)l ? l - aged : 0;
+		if (aged < best)
+		{
+			best = aged;
+			pick = l;
+		}
+	}
+	return (late_pick >= 0 ? late_pick : pick);
+}
+
+/**
+ * sched_take - Takes the most urgent ready task
+ *
+ * @sched: Scheduler
+ *
+ * Return: Task, or NULL once every level is empty
+ */
+static task_t *sched_take(task_sched_t *sched)
+{
+	sched_level_t *level;
+	task_t *task;
+	int l;
+
+	while ((l = sched_pick(sched, task_clock_ns())) >= 0)
+	{
+		level = &sched->levels[l];
+		pthread_mutex_lock(&level->lock);
+		task = level_pop(level);
+		pthread_mutex_unlock(&level->lock);
+		if (task)
+			return (task);
+		/* Another worker emptied the level since the peek */
+	}
+	return (NULL);
+}
+
+/**
+ * sched_submit - Queues a task; thread-safe, and may be called while
+ *                workers run, including from a task
+ *
+ * @sched: Scheduler
+ * @task:  Pending task
+ *
+ * Return: 0 on success, -1 on failure
+ */
+int sched_submit(task_sched_t *sched, task_t *task)
+{
+	sched_level_t *level;
+	int ret;
+
+	if (!sched || !task)
+		return (-1);
+	level = &sched->levels[task->priority < TASK_PRIO_MAX ?
+			       task->priority : TASK_PRIO_MAX - 1];
+	pthread_mutex_lock(&level->lock);
+	ret = level_push(level, task);
+	pthread_mutex_unlock(&level->lock);
+	return (ret);
+}
+
+/**
+ * sched_create - Creates a scheduler holding the pending tasks of a list
+ *
+ * @tasks: List of tasks, or NULL
+ *
+ * Return: Scheduler, to be freed with sched_destroy, or NULL
+ */
+task_sched_t *sched_create(list_t const *tasks)
+{
+	task_sched_t *sched = aligned_alloc(64, sizeof(*sched));
+	node_t *node;
+	int l;
+
+	if (!sched)
+		return (NULL);
+	memset(sched, 0, sizeof(*sched));
+	for (l = 0; l < TASK_PRIO_MAX; l++)
+	{
+		atomic_init(&sched->levels[l].top, SCHED_EMPTY);
+		atomic_init(&sched->levels[l].top_deadline, 0);
+		pthread_mutex_init(&sched->levels[l].lock, NULL);
+	}
+	for (node = tasks ? tasks->head : NULL; node; node = node->next)
+		if (get_task_status(node->content) == PENDING &&
+		    sched_submit(sched, node->content))
+			return (sched_destroy(sched), NULL);
+	return (sched);
+}
+
+/**
+ * exec_tasks_sched - Thread entry executing the tasks of a scheduler, most
+ *                    urgent first, until none is left
+ *
+ * @sched: Scheduler
+ *
+ * Return: NULL
+ */
+void *exec_tasks_sched(task_sched_t *sched)
+{
+	task_worker_stats_t *stats = task_stats_worker();
+	task_t *task;
+
+	topology_pin_worker();
+	while (sched && (task = sched_take(sched)))
+		if (claim_task(task))
+			run_task(task, stats, 0);
+	return (NULL);
+}
+
+/**
+ * sched_destroy - Frees a scheduler; its tasks are left to their owner
+ *
+ * @sched: Scheduler
+ */
+void sched_destroy(task_sched_t *sched)
+{
+	int l;
+
+	if (!sched)
+		return;
+	for (l = 0; l < TASK_PRIO_MAX; l++)
+	{
+		pthread_mutex_destroy(&sched->levels[l].lock);
+		free(sched->levels[l].heap);
+	}
+	free(sched);
+}
@@ -0,0 +1,211 @@
+#include "task_stats.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOAD(x) atomic_load_explicit(&(x), memory_order_relaxed)
+
+static pthread_mutex_t workers_lock = PTHREAD_MUTEX_INITIALIZER;
+static task_worker_stats_t *workers;
+static __thread task_worker_stats_t *tls_worker;
+
+/**
+ * task_clock_ns - Reads the monotonic clock
+ *
+ * Return: CLOCK_MONOTONIC time, in nanoseconds
+ */
+uint64_t task_clock_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t)now.tv_sec * 1000000000 + now.tv_nsec);
+}
+
+/**
+ * task_stats_worker - Gets the calling thread's metrics, registering them
+ *                     on first use; they stay registered until exit
+ *
+ * Return: Worker metrics, or NULL if they could not be allocated
+ */
+task_worker_stats_t *task_stats_worker(void)
+{
+	task_worker_stats_t *worker = tls_worker;
+
+	if (worker)
+		return (worker);
+	worker = calloc(1, sizeof(*worker));
+	if (!worker)
+		return (NULL);
+	pthread_mutex_lock(&workers_lock);
+	worker->next = workers;
+	workers = worker;
+	pthread_mutex_unlock(&workers_lock);
+	tls_worker = worker;
+	return (worker);
+}
+
+/**
+ * task_stats_add - Adds to a counter that only the calling thread writes;
+ *                  a plain add, readable concurrently by snapshots
+ *
+ * @counter: Counter
+ * @n:       Amount to add
+ */
+void task_stats_add(atomic_uint_fast64_t *counter, uint64_t n)
+{
+	atomic_store_explicit(counter, LOAD(*counter) + n,
+			      memory_order_relaxed);
+}
+
+/**
+ * task_hist_record - Records a duration in a single-writer histogram
+ *
+ * @hist: Histogram
+ * @ns:   Duration, in nanoseconds
+ */
+void task_hist_record(task_hist_t *hist, uint64_t ns)
+{
+	int shift = ns < HIST_SUB ? 0 :
+		63 - __builtin_clzll(ns) - HIST_SUB_BITS;
+	size_t i = ns < HIST_SUB ? ns : (size_t)(shift + 1) * HIST_SUB +
+		((ns >> shift) & (HIST_SUB - 1));
+
+	task_stats_add(&hist->buckets[i], 1);
+	task_stats_add(&hist->count, 1);
+	task_stats_add(&hist->sum, ns);
+	if (ns > LOAD(hist->max))
+		atomic_store_explicit(&hist->max, ns, memory_order_relaxed);
+}
+
+/**
+ * task_hist_percentile - Estimates a percentile of a histogram
+ *
+ * @hist: Histogram
+ * @q:    Quantile, between 0 and 1
+ *
+ * Return: Upper bound of the bucket holding the quantile, capped by the
+ * largest sample, in nanoseconds
+ */
+uint64_t task_hist_percentile(task_hist_t const *hist, double q)
+{
+	uint64_t rank = (uint64_t)(q * LOAD(hist->count)), seen = 0, bound;
+	size_t i;
+	int shift;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+	{
+		seen += LOAD(hist->buckets[i]);
+		if (seen > rank || (seen && seen == LOAD(hist->count)))
+			break;
+	}
+	if (i >= HIST_BUCKETS)
+		return (LOAD(hist->max));
+	if (i < HIST_SUB)
+		return (i);
+	shift = i / HIST_SUB - 1;
+	bound = (((uint64_t)HIST_SUB + i % HIST_SUB + 1) << shift) - 1;
+	return (bound < LOAD(hist->max) ? bound : LOAD(hist->max));
+}
+
+/**
+ * hist_merge - Adds a histogram to another
+ *
+ * @dst: Histogram to add to
+ * @src: Histogram to add
+ */
+static void hist_merge(task_hist_t *dst, task_hist_t const *src)
+{
+	size_t i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		dst->buckets[i] += LOAD(src->buckets[i]);
+	dst->count += LOAD(src->count);
+	dst->sum += LOAD(src->sum);
+	if (LOAD(src->max) > dst->max)
+		dst->max = LOAD(src->max);
+}
+
+/**
+ * task_stats_snapshot - Aggregates the metrics of every worker; may run
+ *                       while tasks execute, in which case the counters are
+ *                       each consistent but not with one another
+ *
+ * @stats: Where to store the snapshot
+ */
+void task_stats_snapshot(task_stats_t *stats)
+{
+	task_worker_stats_t const *worker;
+	uint64_t first = UINT64_MAX, last = 0;
+
+	memset(stats, 0, sizeof(*stats));
+	pthread_mutex_lock(&workers_lock);
+	for (worker = workers; worker; worker = worker->next)
+	{
+		stats->workers++;
+		stats->tasks += LOAD(worker->tasks);
+		stats->idle_ns += LOAD(worker->idle_ns);
+		hist_merge(&stats->wait, &worker->wait);
+		hist_merge(&stats->run, &worker->run);
+		if (LOAD(worker->tasks) && LOAD(worker->first_ns) < first)
+			first = LOAD(worker->first_ns);
+		if (LOAD(worker->last_ns) > last)
+			last = LOAD(worker->last_ns);
+	}
+	pthread_mutex_unlock(&workers_lock);
+	if (stats->tasks && last > first)
+		stats->tasks_per_sec = stats->tasks * 1e9 / (last - first);
+}
+
+/**
+ * hist_print - Prints the summary of a histogram
+ *
+ * @stream: Output stream
+ * @name:   Histogram name
+ * @hist:   Histogram
+ */
+static void hist_print(FILE *stream, char const *name, task_hist_t const *hist)
+{
+	uint64_t count = LOAD(hist->count);
+
+	fprintf(stream,
+		"  %-4s mean %lu p50 %lu p90 %lu p99 %lu max %lu (ns)\n", name,
+		(unsigned long)(count ? LOAD(hist->sum) / count : 0),
+		(unsigned long)task_hist_percentile(hist, 0.5),
+		(unsigned long)task_hist_percentile(hist, 0.9),
+		(unsigned long)task_hist_percentile(hist, 0.99),
+		(unsigned long)LOAD(hist->max));
+}
+
+/**
+ * task_stats_dump - Prints a snapshot of the task runtime metrics
+ *
+ * @stream: Output stream
+ */
+void task_stats_dump(FILE *stream)
+{
+	task_stats_t *stats = malloc(sizeof(*stats));
+
+	if (!stats)
+		return;
+	task_stats_snapshot(stats);
+	fprintf(stream, "tasks: %lu on %lu workers, %.0f tasks/s, "
+		"%lu us idle\n", (unsigned long)stats->tasks,
+		(unsigned long)stats->workers, stats->tasks_per_sec,
+		(unsigned long)(stats->idle_ns / 1000));
+	hist_print(stream, "wait", &stats->wait);
+	hist_print(stream, "run", &stats->run);
+	free(stats);
+}
+
+/**
+ * task_stats_exit - Prints the metrics to stderr at exit when the TASK_STATS
+ *                   environment variable is set. They are not freed, since
+ *                   detached workers may still be running.
+ */
+__attribute__((destructor)) static void task_stats_exit(void)
+{
+	if (workers && getenv("TASK_STATS"))
+		task_stats_dump(stderr);
+}
@@ -0,0 +1,85 @@
+#ifndef TASK_STATS_H
+#define TASK_STATS_H
+
+#include <stdatomic.h> /* atomic_uint_fast64_t */
+#include <stdint.h> /* uint64_t */
+#include <stdio.h> /* FILE */
+
+/* Log-linear histogram: 2^HIST_SUB_BITS linear buckets per power of 2 */
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+/**
+ * struct task_hist_s - HDR-style histogram of durations in nanoseconds,
+ *                      with a relative error below 1 / HIST_SUB
+ *
+ * @count:   Number of samples
+ * @sum:     Sum of the samples
+ * @max:     Largest sample
+ * @buckets: Sample counts, see hist_index
+ */
+typedef struct task_hist_s
+{
+	atomic_uint_fast64_t count;
+	atomic_uint_fast64_t sum;
+	atomic_uint_fast64_t max;
+	atomic_uint_fast64_t buckets[HIST_BUCKETS];
+} task_hist_t;
+
+/**
+ * struct task_worker_stats_s - Metrics of one thread running tasks; only
+ *                              written by that thread
+ *
+ * @wait:     Time between create_task and the task start
+ * @run:      Time spent in the task entry
+ * @tasks:    Tasks executed
+ * @idle_ns:  Time spent looking for work without finding any
+ * @first_ns: Start time of the first task
+ * @last_ns:  End time of the last task
+ * @next:     Next registered worker
+ */
+typedef struct task_worker_stats_s
+{
+	task_hist_t wait;
+	task_hist_t run;
+	atomic_uint_fast64_t tasks;
+	atomic_uint_fast64_t idle_ns;
+	atomic_uint_fast64_t first_ns;
+	atomic_uint_fast64_t last_ns;
+	struct task_worker_stats_s *next;
+} task_worker_stats_t;
+
+/**
+ * struct task_stats_s - Snapshot of the task runtime metrics, aggregated
+ *                       over every worker
+ *
+ * @workers:       Number of threads that ran tasks
+ * @tasks:         Tasks executed
+ * @idle_ns:       Idle time, summed over workers
+ * @tasks_per_sec: Tasks executed per second, from the first start to the
+ *                 last completion
+ * @wait:          Queue wait histogram
+ * @run:           Execution time histogram
+ */
+typedef struct task_stats_s
+{
+	uint64_t workers;
+	uint64_t tasks;
+	uint64_t idle_ns;
+	double tasks_per_sec;
+	task_hist_t wait;
+	task_hist_t run;
+} task_stats_t;
+
+/* task_stats.c */
+uint64_t		task_clock_ns(void);
+task_worker_stats_t	*task_stats_worker(void);
+void			task_stats_add(atomic_uint_fast64_t *counter,
+				       uint64_t n);
+void			task_hist_record(task_hist_t *hist, uint64_t ns);
+uint64_t		task_hist_percentile(task_hist_t const *hist, double q);
+void			task_stats_snapshot(task_stats_t *stats);
+void			task_stats_dump(FILE *stream);
+
+#endif /* TASK_STATS_H */
@@ -0,0 +1,293 @@
+#include "tlog.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define TLOG_RING_MASK (TLOG_RING_SIZE - 1)
+#define TLOG_SIG_MASK (TLOG_SIG_CACHE - 1)
+
+/**
+ * struct tlog_sig_s - Parsed format string
+ *
+ * @fmt:   Format string address
+ * @n:     Number of arguments, or -1 if the format cannot be recorded
+ * @kinds: Kind of each argument
+ */
+typedef struct tlog_sig_s
+{
+	char const *fmt;
+	int n;
+	uint8_t kinds[TLOG_MAX_ARGS];
+} tlog_sig_t;
+
+/**
+ * struct tlog_ring_s - Single-producer single-consumer ring of records,
+ *                      written by its thread and drained by tlog_dump
+ *
+ * @records: Records
+ * @head:    Number of records written, owned by the logging thread
+ * @tail:    Number of records drained, owned by tlog_dump
+ * @dropped: Records dropped because the ring was full
+ * @tid:     Kernel thread id of the owner
+ * @sigs:    Direct-mapped cache of parsed format strings
+ * @next:    Next registered ring
+ */
+typedef struct tlog_ring_s
+{
+	tlog_record_t records[TLOG_RING_SIZE];
+	atomic_size_t head;
+	atomic_size_t tail;
+	atomic_size_t dropped;
+	uint32_t tid;
+	tlog_sig_t sigs[TLOG_SIG_CACHE];
+	struct tlog_ring_s *next;
+} tlog_ring_t;
+
+static pthread_mutex_t tlog_lock = PTHREAD_MUTEX_INITIALIZER;
+static tlog_ring_t *tlog_rings;
+static tlog_clock_t tlog_calibration;
+static __thread tlog_ring_t *tls_ring;
+
+/**
+ * tlog_ticks - Reads the record clock: the TSC where available, since it
+ *              costs a fraction of clock_gettime
+ *
+ * Return: Current tick count
+ */
+static inline uint64_t tlog_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return (__rdtsc());
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t)now.tv_sec * 1000000000 + now.tv_nsec);
+#endif
+}
+
+/**
+ * tlog_sample - Samples the record clock and CLOCK_MONOTONIC together
+ *
+ * @ticks: Where to store the tick count
+ * @ns:    Where to store the nanoseconds
+ */
+static void tlog_sample(uint64_t *ticks, uint64_t *ns)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	*ticks = tlog_ticks();
+	*ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * tlog_ring_get - Gets the calling thread's ring, registering it on first
+ *                 use. Rings outlive their thread so they can be dumped.
+ *
+ * Return: The ring, or NULL
+ */
+static tlog_ring_t *tlog_ring_get(void)
+{
+	tlog_ring_t *ring = tls_ring;
+
+	if (ring)
+		return (ring);
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return (NULL);
+	ring->tid = (uint32_t)syscall(SYS_gettid);
+	pthread_mutex_lock(&tlog_lock);
+	if (!tlog_rings)
+		tlog_sample(&tlog_calibration.ticks0, &tlog_calibration.ns0);
+	ring->next = tlog_rings;
+	tlog_rings = ring;
+	pthread_mutex_unlock(&tlog_lock);
+	tls_ring = ring;
+	return (ring);
+}
+
+/**
+ * tlog_sig_get - Parses a format string, through the thread's cache
+ *
+ * @ring:   Calling thread's ring
+ * @format: Format string
+ *
+ * Return: Parsed format string
+ */
+static tlog_sig_t const *tlog_sig_get(tlog_ring_t *ring, char const *format)
+{
+	tlog_sig_t *sig = &ring->sigs[((uintptr_t)format >> 3) & TLOG_SIG_MASK];
+
+	if (sig->fmt != format)
+	{
+		sig->fmt = format;
+		sig->n = tlog_signature(format, sig->kinds);
+	}
+	return (sig);
+}
+
+/**
+ * tlog_pack - Copies the raw arguments of a log call into a record. A
+ *             string is truncated so the arguments after it keep a slot,
+ *             and the record is then flagged TLOG_TRUNCATED.
+ *
+ * @rec:  Record
+ * @sig:  Parsed format string
+ * @args: Arguments
+ */
+static void tlog_pack(tlog_record_t *rec, tlog_sig_t const *sig, va_list args)
+{
+	int i, slot = 0, room;
+	char const *str;
+	char *dst;
+	double d;
+
+	rec->flags = 0;
+	for (i = 0; i < sig->n && slot < TLOG_MAX_ARGS; i++)
+		if (sig->kinds[i] == TLOG_INT)
+			rec->args[slot++] = (uint64_t)va_arg(args, int);
+		else if (sig->kinds[i] == TLOG_LONG)
+			rec->args[slot++] = (uint64_t)va_arg(args, long);
+		else if (sig->kinds[i] == TLOG_DOUBLE)
+		{
+			d = va_arg(args, double);
+			memcpy(&rec->args[slot++], &d, sizeof(d));
+		}
+		else
+		{
+			str = va_arg(args, char const *);
+			str = str ? str : "(null)";
+			room = TLOG_MAX_ARGS - slot - (sig->n - i - 1);
+			room = (room > 1 ? room : 1) * sizeof(uint64_t) - 1;
+			dst = (char *)&rec->args[slot];
+			while (room-- && *str)
+				*dst++ = *str++;
+			*dst = '\0';
+			if (*str)
+				rec->flags |= TLOG_TRUNCATED;
+			slot += tlog_str_slots((char *)&rec->args[slot]);
+		}
+	rec->nargs = i;
+}
+
+/**
+ * tlog - Records a log line without formatting it: the timestamp, thread,
+ *        format string address and raw arguments go to the calling
+ *        thread's ring, to be rendered offline from a tlog_dump file.
+ *        The format string must outlive the dump (e.g. a literal).
+ *        Formats with more than TLOG_MAX_ARGS arguments, `*` widths or
+ *        precisions, long doubles, wide strings or %n are rejected.
+ *
+ * @format: printf-like format string
+ *
+ * Return: 0 on success, -1 if the record was dropped or the format rejected
+ */
+int tlog(char const *format, ...)
+{
+	tlog_ring_t *ring = tlog_ring_get();
+	tlog_sig_t const *sig;
+	tlog_record_t *rec;
+	va_list args;
+	size_t head;
+
+	if (!ring)
+		return (-1);
+	sig = tlog_sig_get(ring, format);
+	if (sig->n < 0)
+		return (-1);
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) ==
+	    TLOG_RING_SIZE)
+	{
+		atomic_fetch_add_explicit(&ring->dropped, 1,
+					  memory_order_relaxed);
+		return (-1);
+	}
+	rec = &ring->records[head & TLOG_RING_MASK];
+	rec->ts = tlog_ticks();
+	rec->fmt = (uintptr_t)format;
+	rec->tid = ring->tid;
+	va_start(args, format);
+	tlog_pack(rec, sig, args);
+	va_end(args);
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+	return (0);
+}
+
+/**
+ * tlog_dump_ring - Drains a ring into a dump file
+ *
+ * @ring:  Ring
+ * @file:  Dump file
+ * @seen:  Format strings already written to the file, direct-mapped
+ *
+ * Return: Number of records written
+ */
+static size_t tlog_dump_ring(tlog_ring_t *ring, FILE *file, uint64_t *seen)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	size_t n = head - tail;
+	tlog_record_t *rec;
+	uint32_t len;
+
+	for (; tail != head; tail++)
+	{
+		rec = &ring->records[tail & TLOG_RING_MASK];
+		if (seen[(rec->fmt >> 3) & TLOG_SIG_MASK] != rec->fmt)
+		{
+			seen[(rec->fmt >> 3) & TLOG_SIG_MASK] = rec->fmt;
+			len = strlen((char const *)(uintptr_t)rec->fmt);
+			fputc(TLOG_ENTRY_STRING, file);
+			fwrite(&rec->fmt, sizeof(rec->fmt), 1, file);
+			fwrite(&len, sizeof(len), 1, file);
+			fwrite((char const *)(uintptr_t)rec->fmt, 1, len, file);
+		}
+		fputc(TLOG_ENTRY_RECORD, file);
+		fwrite(rec, sizeof(*rec), 1, file);
+	}
+	atomic_store_explicit(&ring->tail, head, memory_order_release);
+	return (n);
+}
+
+/**
+ * tlog_dump - Appends every pending record of every thread to a binary
+ *             file, to be rendered by the tlog_decode tool. Successive runs
+ *             may append to the same file: each dump starts with the clock
+ *             entry of its run.
+ *
+ * @path: Path of the dump file
+ *
+ * Return: Number of records written, or -1 if the file cannot be opened
+ */
+int tlog_dump(char const *path)
+{
+	uint64_t seen[TLOG_SIG_CACHE] = {0};
+	FILE *file = fopen(path, "ab");
+	tlog_ring_t *ring;
+	size_t n = 0;
+
+	if (!file)
+		return (-1);
+	if (ftell(file) == 0)
+		fwrite(TLOG_MAGIC, 1, sizeof(TLOG_MAGIC) - 1, file);
+	pthread_mutex_lock(&tlog_lock);
+	tlog_sample(&tlog_calibration.ticks1, &tlog_calibration.ns1);
+	fputc(TLOG_ENTRY_CLOCK, file);
+	fwrite(&tlog_calibration, sizeof(tlog_calibration), 1, file);
+	for (ring = tlog_rings; ring; ring = ring->next)
+		n += tlog_dump_ring(ring, file, seen);
+	pthread_mutex_unlock(&tlog_lock);
+	fclose(file);
+	return ((int)n);
+}
@@ -0,0 +1,91 @@
+#ifndef TLOG_H
+#define TLOG_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+
+/* Argument slots of a record; a %s argument is copied into its slots */
+#define TLOG_MAX_ARGS 5
+/* Records per thread ring, a power of 2 */
+#define TLOG_RING_SIZE 4096
+/* Parsed format strings cached per thread, a power of 2 */
+#define TLOG_SIG_CACHE 64
+#define TLOG_MAGIC "TLOGBIN1"
+
+/* File entries: a format string, a record, a clock calibration */
+#define TLOG_ENTRY_STRING 'S'
+#define TLOG_ENTRY_RECORD 'R'
+#define TLOG_ENTRY_CLOCK 'C'
+
+/**
+ * enum tlog_arg_e - Kind of a recorded argument
+ *
+ * @TLOG_INT:    int (and promoted char/short), stored in one slot
+ * @TLOG_LONG:   long, long long, size_t, pointers; one slot
+ * @TLOG_DOUBLE: double, stored bit for bit in one slot
+ * @TLOG_STR:    string, copied NUL-terminated into the remaining slots
+ * @TLOG_BAD:    conversion tlog cannot record: `*` width or precision,
+ *               long double, wide string, %n
+ */
+typedef enum tlog_arg_e
+{
+	TLOG_INT = 0,
+	TLOG_LONG,
+	TLOG_DOUBLE,
+	TLOG_STR,
+	TLOG_BAD
+} tlog_arg_t;
+
+/* Record flag: a string argument was cut to fit the record */
+#define TLOG_TRUNCATED 1
+
+/**
+ * struct tlog_record_s - One binary log record, as written to disk
+ *
+ * @ts:    Timestamp in clock ticks (the TSC on x86, nanoseconds elsewhere),
+ *         converted with the clock calibration entries
+ * @fmt:   Address of the format string, resolved through the string entries
+ * @tid:   Kernel thread id of the logging thread
+ * @nargs: Number of arguments recorded
+ * @flags: TLOG_TRUNCATED, or 0
+ * @args:  Raw arguments
+ */
+typedef struct tlog_record_s
+{
+	uint64_t ts;
+	uint64_t fmt;
+	uint32_t tid;
+	uint16_t nargs;
+	uint16_t flags;
+	uint64_t args[TLOG_MAX_ARGS];
+} tlog_record_t;
+
+/**
+ * struct tlog_clock_s - Clock calibration, written at each dump: two
+ *                       (ticks, CLOCK_MONOTONIC nanoseconds) samples. The
+ *                       first identifies the run: the string and record
+ *                       entries that follow a clock entry belong to its run.
+ *
+ * @ticks0: Ticks at the first sample, taken when logging started
+ * @ns0:    Nanoseconds at the first sample
+ * @ticks1: Ticks at the second sample, taken by the dump
+ * @ns1:    Nanoseconds at the second sample
+ */
+typedef struct tlog_clock_s
+{
+	uint64_t ticks0;
+	uint64_t ns0;
+	uint64_t ticks1;
+	uint64_t ns1;
+} tlog_clock_t;
+
+/* tlog.c */
+int		tlog(char const *format, ...);
+int		tlog_dump(char const *path);
+
+/* tlog_format.c */
+char const	*tlog_next_spec(char const *p, size_t *len, tlog_arg_t *kind);
+int		tlog_signature(char const *format, uint8_t *kinds);
+size_t		tlog_str_slots(char const *str);
+
+#endif /* TLOG_H */
@@ -0,0 +1,90 @@
+#include "tlog.h"
+#include <string.h>
+
+/**
+ * tlog_next_spec - Finds the next conversion specification of a format
+ *                  string that consumes an argument
+ *
+ * @p:    Position in the format string
+ * @len:  Where to store the length of the specification, '%' included
+ * @kind: Where to store the kind of argument it consumes; TLOG_BAD for `*`
+ *        widths and precisions, long doubles, wide strings and %n
+ *
+ * Return: Pointer to the '%' of the specification, or NULL if none is left
+ */
+char const *tlog_next_spec(char const *p, size_t *len, tlog_arg_t *kind)
+{
+	char const *s;
+	int wide = 0, ldouble = 0, star;
+
+	while ((p = strchr(p, '%')) && p[1] == '%')
+		p += 2;
+	if (!p)
+		return (NULL);
+	s = p + 1;
+	s += strspn(s, "-+ #0'");
+	star = *s == '*';
+	s += strspn(s, "0123456789");
+	if (*s == '.')
+	{
+		star |= s[1] == '*';
+		s += 1 + strspn(s + 1, "0123456789");
+	}
+	for (; *s && strchr("hlLqjzt", *s); s++)
+	{
+		wide |= *s != 'h';
+		ldouble |= *s == 'L' || *s == 'q';
+	}
+	if (*s && strchr("fFeEgGaA", *s))
+		*kind = ldouble ? TLOG_BAD : TLOG_DOUBLE;
+	else if (*s == 's')
+		*kind = wide ? TLOG_BAD : TLOG_STR;
+	else if (*s == 'c')
+		*kind = TLOG_INT;
+	else if (*s == 'p' || (wide && *s != 'n'))
+		*kind = TLOG_LONG;
+	else
+		*kind = *s && *s != 'n' ? TLOG_INT : TLOG_BAD;
+	if (star)
+		*kind = TLOG_BAD;
+	*len = (*s ? s + 1 : s) - p;
+	return (p);
+}
+
+/**
+ * tlog_signature - Lists the kinds of arguments a format string consumes
+ *
+ * @format: Format string
+ * @kinds:  Array of TLOG_MAX_ARGS kinds to fill
+ *
+ * Return: Number of arguments, or -1 if there are more than TLOG_MAX_ARGS
+ *         or one of them cannot be recorded (see tlog_next_spec)
+ */
+int tlog_signature(char const *format, uint8_t *kinds)
+{
+	tlog_arg_t kind;
+	size_t len;
+	int n = 0;
+
+	while ((format = tlog_next_spec(format, &len, &kind)))
+	{
+		if (kind == TLOG_BAD || n == TLOG_MAX_ARGS)
+			return (-1);
+		kinds[n++] = kind;
+		format += len;
+	}
+	return (n);
+}
+
+/**
+ * tlog_str_slots - Computes the number of argument slots used by a string
+ *                  copied into a record
+ *
+ * @str: NUL-terminated string, as stored in the record
+ *
+ * Return: Number of 8-byte slots
+ */
+size_t tlog_str_slots(char const *str)
+{
+	return ((strlen(str) + sizeof(uint64_t)) / sizeof(uint64_t));
+}
@@ -0,0 +1,305 @@
+#include "../tlog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Renders a binary log written by tlog_dump as text, one line per record,
+ * sorted by timestamp. Records whose string argument was cut to fit are
+ * marked "(truncated)".
+ *
+ * make tlog_decode (from the multithreading directory)
+ * ./tlog_decode <dump file>
+ */
+
+/**
+ * struct tlog_string_s - Format string read from a dump
+ *
+ * @run:  Run the string belongs to
+ * @addr: Address of the string in the logging process
+ * @str:  String
+ */
+typedef struct tlog_string_s
+{
+	size_t run;
+	uint64_t addr;
+	char *str;
+} tlog_string_t;
+
+/**
+ * struct tlog_entry_s - Record read from a dump
+ *
+ * @run: Run the record belongs to
+ * @ns:  Timestamp, in CLOCK_MONOTONIC nanoseconds
+ * @rec: Record
+ */
+typedef struct tlog_entry_s
+{
+	size_t run;
+	uint64_t ns;
+	tlog_record_t rec;
+} tlog_entry_t;
+
+/**
+ * struct tlog_file_s - Contents of a dump file, which may hold the dumps of
+ *                      several runs: format string addresses only mean
+ *                      something within their run, and each run has its own
+ *                      clock calibration
+ *
+ * @strings:  Format strings
+ * @nstrings: Number of format strings
+ * @records:  Records, in file order
+ * @nrecords: Number of records
+ * @clocks:   Latest clock calibration of each run
+ * @nruns:    Number of runs
+ */
+typedef struct tlog_file_s
+{
+	tlog_string_t *strings;
+	size_t nstrings;
+	tlog_entry_t *records;
+	size_t nrecords;
+	tlog_clock_t *clocks;
+	size_t nruns;
+} tlog_file_t;
+
+/**
+ * put_literal - Prints the literal part of a format string
+ *
+ * @s:   Literal text
+ * @len: Length of the text
+ */
+static void put_literal(char const *s, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		putchar(s[i]);
+		if (s[i] == '%' && i + 1 < len && s[i + 1] == '%')
+			i++;
+	}
+}
+
+/**
+ * render - Prints the message of a record
+ *
+ * @fmt: Format string of the record
+ * @rec: Record
+ */
+static void render(char const *fmt, tlog_record_t const *rec)
+{
+	char spec[64];
+	char const *p;
+	size_t len, slot = 0;
+	tlog_arg_t kind;
+	uint64_t const *a = rec->args;
+	double d;
+	int i;
+
+	for (i = 0; (p = tlog_next_spec(fmt, &len, &kind)); i++, fmt = p + len)
+	{
+		put_literal(fmt, p - fmt);
+		if (i >= rec->nargs || slot >= TLOG_MAX_ARGS ||
+		    len >= sizeof(spec))
+		{
+			fwrite(p, 1, len, stdout);
+			continue;
+		}
+		memcpy(spec, p, len);
+		spec[len] = '\0';
+		if (kind == TLOG_INT)
+			printf(spec, (int)a[slot++]);
+		else if (kind == TLOG_LONG)
+			printf(spec, (long)a[slot++]);
+		else if (kind == TLOG_DOUBLE)
+			memcpy(&d, &a[slot++], sizeof(d)), printf(spec, d);
+		else
+		{
+			printf(spec, (char const *)&a[slot]);
+			slot += tlog_str_slots((char const *)&a[slot]);
+		}
+	}
+	put_literal(fmt, strlen(fmt));
+}
+
+/**
+ * read_clock - Reads a clock entry and finds the run it belongs to, from
+ *              the first sample, which each run takes once
+ *
+ * @file: Dump file, positioned after the entry type
+ * @dump: Contents read so far
+ * @run:  Where to store the run of the entry
+ *
+ * Return: 0 on success, -1 on a truncated file
+ */
+static int read_clock(FILE *file, tlog_file_t *dump, size_t *run)
+{
+	tlog_clock_t clock;
+
+	if (fread(&clock, sizeof(clock), 1, file) != 1)
+		return (-1);
+	for (*run = 0; *run < dump->nruns; (*run)++)
+		if (dump->clocks[*run].ticks0 == clock.ticks0 &&
+		    dump->clocks[*run].ns0 == clock.ns0)
+			break;
+	if (*run == dump->nruns)
+	{
+		dump->clocks = realloc(dump->clocks,
+			sizeof(clock) * (dump->nruns + 1));
+		dump->nruns++;
+	}
+	dump->clocks[*run] = clock;
+	return (0);
+}
+
+/**
+ * read_dump - Reads a dump file
+ *
+ * @file: Dump file, positioned after the magic
+ * @dump: Where to store the contents
+ *
+ * Return: 0 on success, -1 on a malformed or truncated file
+ */
+static int read_dump(FILE *file, tlog_file_t *dump)
+{
+	tlog_string_t *s;
+	tlog_entry_t *e;
+	size_t run = 0;
+	uint32_t len;
+	int entry;
+
+	while ((entry = fgetc(file)) != EOF)
+		if (entry == TLOG_ENTRY_CLOCK)
+		{
+			if (read_clock(file, dump, &run))
+				return (-1);
+		}
+		else if (!dump->nruns)
+			return (-1); /* Every dump starts with a clock entry */
+		else if (entry == TLOG_ENTRY_STRING)
+		{
+			dump->strings = realloc(dump->strings,
+				sizeof(*s) * (dump->nstrings + 1));
+			s = &dump->strings[dump->nstrings++];
+			s->run = run;
+			if (fread(&s->addr, sizeof(s->addr), 1, file) != 1 ||
+			    fread(&len, sizeof(len), 1, file) != 1 ||
+			    !(s->str = calloc(len + 1, 1)) ||
+			    fread(s->str, 1, len, file) != len)
+				return (-1);
+		}
+		else if (entry == TLOG_ENTRY_RECORD)
+		{
+			dump->records = realloc(dump->records,
+				sizeof(*e) * (dump->nrecords + 1));
+			e = &dump->records[dump->nrecords++];
+			e->run = run;
+			if (fread(&e->rec, sizeof(e->rec), 1, file) != 1)
+				return (-1);
+		}
+		else
+			return (-1);
+	return (0);
+}
+
+/**
+ * to_ns - Converts a record timestamp to CLOCK_MONOTONIC nanoseconds
+ *
+ * @c:  Clock calibration
+ * @ts: Timestamp, in ticks
+ *
+ * Return: Nanoseconds
+ */
+static uint64_t to_ns(tlog_clock_t const *c, uint64_t ts)
+{
+	double rate = c->ticks1 > c->ticks0 ?
+		(double)(c->ns1 - c->ns0) / (c->ticks1 - c->ticks0) : 1;
+
+	return (c->ns0 + (int64_t)((double)(int64_t)(ts - c->ticks0) * rate));
+}
+
+/**
+ * find_format - Finds the format string of a record
+ *
+ * @dump: Contents of the dump
+ * @e:    Record
+ *
+ * Return: Format string
+ */
+static char const *find_format(tlog_file_t const *dump, tlog_entry_t const *e)
+{
+	size_t i;
+
+	for (i = 0; i < dump->nstrings; i++)
+		if (dump->strings[i].run == e->run &&
+		    dump->strings[i].addr == e->rec.fmt)
+			return (dump->strings[i].str);
+	return ("<unknown format>\n");
+}
+
+/**
+ * by_time - qsort comparator ordering records by time, then thread
+ *
+ * @a: First record
+ * @b: Second record
+ *
+ * Return: Negative, zero or positive
+ */
+static int by_time(void const *a, void const *b)
+{
+	tlog_entry_t const *ea = a, *eb = b;
+
+	if (ea->ns != eb->ns)
+		return (ea->ns < eb->ns ? -1 : 1);
+	return ((ea->rec.tid > eb->rec.tid) - (ea->rec.tid < eb->rec.tid));
+}
+
+/**
+ * main - Entry point
+ *
+ * @ac: Arguments count
+ * @av: Arguments vector
+ *
+ * Return: EXIT_SUCCESS, or EXIT_FAILURE on error
+ */
+int main(int ac, char **av)
+{
+	char magic[sizeof(TLOG_MAGIC) - 1];
+	tlog_file_t dump = {0};
+	tlog_entry_t *e;
+	FILE *file;
+	size_t i;
+	int status;
+
+	if (ac != 2)
+		return (fprintf(stderr, "Usage: %s <dump file>\n", av[0]),
+			EXIT_FAILURE);
+	file = fopen(av[1], "rb");
+	if (!file || fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+	    memcmp(magic, TLOG_MAGIC, sizeof(magic)))
+		return (fprintf(stderr, "%s: not a tlog dump\n", av[1]),
+			EXIT_FAILURE);
+	status = read_dump(file, &dump) ? EXIT_FAILURE : EXIT_SUCCESS;
+	if (status == EXIT_FAILURE)
+		fprintf(stderr, "%s: truncated dump\n", av[1]);
+	fclose(file);
+	for (i = 0; i < dump.nrecords; i++)
+		dump.records[i].ns = to_ns(&dump.clocks[dump.records[i].run],
+					   dump.records[i].rec.ts);
+	qsort(dump.records, dump.nrecords, sizeof(*dump.records), by_time);
+	for (i = 0; i < dump.nrecords; i++)
+	{
+		e = &dump.records[i];
+		printf("%lu.%09lu [%u] %s", (unsigned long)(e->ns / 1000000000),
+		       (unsigned long)(e->ns % 1000000000), e->rec.tid,
+		       e->rec.flags & TLOG_TRUNCATED ? "(truncated) " : "");
+		render(find_format(&dump, e), &e->rec);
+	}
+	for (i = 0; i < dump.nstrings; i++)
+		free(dump.strings[i].str);
+	free(dump.strings);
+	free(dump.records);
+	free(dump.clocks);
+	return (status);
+}
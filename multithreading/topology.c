@@ -0,0 +1,320 @@
+#define _GNU_SOURCE
+#include "topology.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static cpu_topology_t topology;
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+/* Position + 1 of each CPU number in topology.cpus, 0 when offline */
+static int cpu_index[TOPO_MAX_CPUS];
+static int pin_workers;
+static atomic_int next_slot;
+static __thread int tls_pinned;
+
+/**
+ * read_int - Reads the integer in a sysfs file; for a CPU list ("0-3,8"),
+ *            that is its first CPU
+ *
+ * @path: File path
+ * @def:  Value returned if the file cannot be read
+ *
+ * Return: The integer
+ */
+static int read_int(char const *path, int def)
+{
+	FILE *file = fopen(path, "r");
+	int value = def;
+
+	if (file)
+	{
+		if (fscanf(file, "%d", &value) != 1)
+			value = def;
+		fclose(file);
+	}
+	return (value);
+}
+
+/**
+ * read_online - Reads the list of online CPUs
+ *
+ * @cpus: Array of TOPO_MAX_CPUS entries to fill
+ *
+ * Return: Number of online CPUs
+ */
+static int read_online(cpu_info_t *cpus)
+{
+	FILE *file = fopen(TOPO_SYSFS "/online", "r");
+	int n = 0, lo, hi;
+	char sep;
+
+	while (file && fscanf(file, "%d", &lo) == 1)
+	{
+		hi = lo;
+		sep = (char)fgetc(file);
+		if (sep == '-' && fscanf(file, "%d", &hi) == 1)
+			sep = (char)fgetc(file);
+		for (; lo <= hi && n < TOPO_MAX_CPUS; lo++)
+			cpus[n++].id = lo;
+		if (sep != ',')
+			break;
+	}
+	if (file)
+		fclose(file);
+	return (n);
+}
+
+/**
+ * read_cpu - Reads the core, SMT rank, L3 domain and node of a CPU
+ *
+ * @cpu: CPU, with its id set
+ */
+static void read_cpu(cpu_info_t *cpu)
+{
+	char path[256];
+	int i, node;
+
+	snprintf(path, sizeof(path),
+		 TOPO_SYSFS "/cpu%d/topology/core_cpus_list", cpu->id);
+	cpu->core = read_int(path, -1);
+	if (cpu->core < 0)
+	{
+		snprintf(path, sizeof(path),
+			 TOPO_SYSFS "/cpu%d/topology/thread_siblings_list",
+			 cpu->id);
+		cpu->core = read_int(path, cpu->id);
+	}
+	cpu->l3 = -1;
+	for (i = 0; cpu->l3 < 0 && i < 8; i++)
+	{
+		snprintf(path, sizeof(path),
+			 TOPO_SYSFS "/cpu%d/cache/index%d/level", cpu->id, i);
+		if (read_int(path, 0) != 3)
+			continue;
+		snprintf(path, sizeof(path),
+			 TOPO_SYSFS "/cpu%d/cache/index%d/shared_cpu_list",
+			 cpu->id, i);
+		cpu->l3 = read_int(path, -1);
+	}
+	cpu->node = 0;
+	for (node = 0; node < TOPO_MAX_CPUS; node++)
+	{
+		snprintf(path, sizeof(path), TOPO_SYSFS "/cpu%d/node%d",
+			 cpu->id, node);
+		if (!access(path, F_OK))
+		{
+			cpu->node = node;
+			break;
+		}
+	}
+}
+
+/**
+ * cpu_compare - Orders CPUs for placement: SMT rank, L3 domain, CPU number
+ *
+ * @a: First CPU
+ * @b: Second CPU
+ *
+ * Return: Negative, zero or positive
+ */
+static int cpu_compare(void const *a, void const *b)
+{
+	cpu_info_t const *x = a, *y = b;
+
+	if (x->smt_rank != y->smt_rank)
+		return (x->smt_rank - y->smt_rank);
+	if (x->l3 != y->l3)
+		return (x->l3 - y->l3);
+	return (x->id - y->id);
+}
+
+/**
+ * count_distinct - Counts the distinct values of a field of the CPUs
+ *
+ * @offset: Offset of the int field in cpu_info_t
+ *
+ * Return: Number of distinct values
+ */
+static int count_distinct(size_t offset)
+{
+	int i, j, n = 0;
+
+	for (i = 0; i < topology.ncpus; i++)
+	{
+		for (j = 0; j < i; j++)
+			if (*(int *)((char *)&topology.cpus[j] + offset) ==
+			    *(int *)((char *)&topology.cpus[i] + offset))
+				break;
+		n += j == i;
+	}
+	return (n);
+}
+
+/**
+ * read_allowed - Keeps the online CPUs of the affinity mask inherited by
+ *                the calling thread, normally that of the process, so that
+ *                taskset and cgroup cpusets bound the placement slots
+ */
+static void read_allowed(void)
+{
+	int i, j, masked;
+	cpu_set_t set;
+	cpu_info_t *cpu;
+
+	masked = !sched_getaffinity(0, sizeof(set), &set);
+	for (i = 0; i < topology.ncpus; i++)
+	{
+		cpu = &topology.cpus[i];
+		if (!masked ||
+		    (cpu->id < CPU_SETSIZE && CPU_ISSET(cpu->id, &set)))
+			topology.allowed[topology.nallowed++] = *cpu;
+	}
+	if (!topology.nallowed)
+	{
+		memcpy(topology.allowed, topology.cpus,
+		       sizeof(*topology.cpus) * topology.ncpus);
+		topology.nallowed = topology.ncpus;
+	}
+	for (i = 0; i < topology.nallowed; i++)
+	{
+		cpu = &topology.allowed[i];
+		for (cpu->smt_rank = 0, j = 0; j < i; j++)
+			cpu->smt_rank += topology.allowed[j].core == cpu->core;
+		topology.allowed_cores += !cpu->smt_rank;
+	}
+	qsort(topology.allowed, topology.nallowed, sizeof(*topology.allowed),
+	      cpu_compare);
+}
+
+/**
+ * topology_init - Discovers the topology, once. Without sysfs, every
+ *                 online CPU is its own core in a single L3 domain.
+ */
+static void topology_init(void)
+{
+	int i, j;
+
+	topology.ncpus = read_online(topology.cpus);
+	if (!topology.ncpus)
+	{
+		topology.ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		topology.ncpus = topology.ncpus < 1 ? 1 : topology.ncpus;
+		topology.ncpus = topology.ncpus > TOPO_MAX_CPUS ?
+			TOPO_MAX_CPUS : topology.ncpus;
+		for (i = 0; i < topology.ncpus; i++)
+			topology.cpus[i].id = i;
+	}
+	for (i = 0; i < topology.ncpus; i++)
+	{
+		read_cpu(&topology.cpus[i]);
+		if (topology.cpus[i].l3 < 0)
+			topology.cpus[i].l3 = 0;
+		for (j = 0; j < i; j++)
+			topology.cpus[i].smt_rank += topology.cpus[j].core ==
+				topology.cpus[i].core;
+	}
+	topology.ncores = count_distinct(offsetof(cpu_info_t, core));
+	topology.nl3 = count_distinct(offsetof(cpu_info_t, l3));
+	topology.nnodes = count_distinct(offsetof(cpu_info_t, node));
+	qsort(topology.cpus, topology.ncpus, sizeof(*topology.cpus),
+	      cpu_compare);
+	for (i = 0; i < topology.ncpus; i++)
+		if (topology.cpus[i].id < TOPO_MAX_CPUS)
+			cpu_index[topology.cpus[i].id] = i + 1;
+	read_allowed();
+	pin_workers = getenv("TASK_PIN") != NULL;
+}
+
+/**
+ * topology_get - Gets the CPU topology
+ *
+ * Return: Topology, discovered on first use
+ */
+cpu_topology_t const *topology_get(void)
+{
+	pthread_once(&topology_once, topology_init);
+	return (&topology);
+}
+
+/**
+ * topology_cpu - Looks a CPU up
+ *
+ * @cpu: CPU number
+ *
+ * Return: CPU, or NULL if it is not online
+ */
+cpu_info_t const *topology_cpu(int cpu)
+{
+	cpu_topology_t const *topo = topology_get();
+
+	if (cpu < 0 || cpu >= TOPO_MAX_CPUS || !cpu_index[cpu])
+		return (NULL);
+	return (&topo->cpus[cpu_index[cpu] - 1]);
+}
+
+/**
+ * topology_pin - Pins the calling thread to the CPU of a placement slot.
+ *                Consecutive slots land on distinct physical cores of the
+ *                same L3 domain first, and only share cores (SMT siblings)
+ *                once every core has a worker.
+ *
+ * @slot: Placement slot, wrapping around the allowed CPUs
+ *
+ * Return: CPU number, or -1 if the thread could not be pinned
+ */
+int topology_pin(int slot)
+{
+	cpu_topology_t const *topo = topology_get();
+	int cpu = topo->allowed[(slot < 0 ? -slot : slot) % topo->nallowed].id;
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+		return (-1);
+	return (cpu);
+}
+
+/**
+ * topology_current_l3 - Gets the L3 domain the calling thread runs on
+ *
+ * Return: L3 domain, or -1 if unknown
+ */
+int topology_current_l3(void)
+{
+	cpu_info_t const *cpu = topology_cpu(sched_getcpu());
+
+	return (cpu ? cpu->l3 : -1);
+}
+
+/**
+ * topology_claim_slot - Hands out the next placement slot. The parallel_for
+ *                       pool threads and the pinned task workers share the
+ *                       slots, so that they land on distinct CPUs.
+ *
+ * Return: Placement slot
+ */
+int topology_claim_slot(void)
+{
+	return (atomic_fetch_add(&next_slot, 1));
+}
+
+/**
+ * topology_pin_worker - Pins the calling task worker to the next placement
+ *                       slot, once per thread. Worker threads belong to the
+ *                       application, so this only happens when the TASK_PIN
+ *                       environment variable is set.
+ */
+void topology_pin_worker(void)
+{
+	topology_get();
+	if (!pin_workers || tls_pinned)
+		return;
+	tls_pinned = 1;
+	topology_pin(topology_claim_slot());
+}
@@ -0,0 +1,62 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+/* Largest number of CPUs handled */
+#define TOPO_MAX_CPUS 1024
+#ifndef TOPO_SYSFS
+#define TOPO_SYSFS "/sys/devices/system/cpu"
+#endif
+
+/**
+ * struct cpu_info_s - Placement of one online CPU
+ *
+ * @id:       CPU number
+ * @core:     Physical core, as the lowest CPU number among its SMT siblings
+ * @smt_rank: Rank of the CPU among the SMT siblings of its core, 0 first
+ * @l3:       L3 domain, the lowest CPU number sharing the L3 cache
+ * @node:     NUMA node
+ */
+typedef struct cpu_info_s
+{
+	int id;
+	int core;
+	int smt_rank;
+	int l3;
+	int node;
+} cpu_info_t;
+
+/**
+ * struct cpu_topology_s - Online CPUs, read once from sysfs
+ *
+ * @ncpus:  Number of online CPUs
+ * @ncores: Number of physical cores
+ * @nl3:    Number of L3 domains
+ * @nnodes: Number of NUMA nodes
+ * @cpus:   CPUs, in placement order: one CPU per core first, grouped by
+ *          L3 domain, then the remaining SMT siblings
+ * @nallowed:      Number of CPUs in the affinity mask the process inherited
+ * @allowed_cores: Number of physical cores among them
+ * @allowed:       Those CPUs, in placement order, their SMT ranks counted
+ *                 among them; the placement slots wrap around them
+ */
+typedef struct cpu_topology_s
+{
+	int ncpus;
+	int ncores;
+	int nl3;
+	int nnodes;
+	cpu_info_t cpus[TOPO_MAX_CPUS];
+	int nallowed;
+	int allowed_cores;
+	cpu_info_t allowed[TOPO_MAX_CPUS];
+} cpu_topology_t;
+
+/* topology.c */
+cpu_topology_t const	*topology_get(void);
+cpu_info_t const	*topology_cpu(int cpu);
+int			topology_pin(int slot);
+int			topology_claim_slot(void);
+int			topology_current_l3(void);
+void			topology_pin_worker(void);
+
+#endif /* TOPOLOGY_H */
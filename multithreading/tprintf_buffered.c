@@ -0,0 +1,489 @@
+#include "multithreading.h"
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * struct tbuf_s - Block of formatted lines handed to the writer thread
+ *
+ * @next: Next buffer in the writer queue
+ * @done: For flush markers, semaphore posted once the marker is reached
+ * @stop: Whether the writer thread should exit after this buffer
+ * @cap:  Capacity of data
+ * @len:  Number of bytes used in data
+ * @data: Formatted lines, never split across buffers
+ */
+typedef struct tbuf_s
+{
+	struct tbuf_s *_Atomic next;
+	sem_t *done;
+	int stop;
+	size_t cap;
+	size_t len;
+	char data[];
+} tbuf_t;
+
+/**
+ * struct tqueue_s - Lock-free multi-producer single-consumer queue of
+ *                   buffers (Vyukov's intrusive queue)
+ *
+ * @head:  Last pushed buffer; producers exchange it
+ * @tail:  Next buffer to pop; only touched by the writer thread
+ * @ready: Counts the buffers pushed, to wake the writer up
+ */
+typedef struct tqueue_s
+{
+	tbuf_t *_Atomic head;
+	tbuf_t *tail;
+	sem_t ready;
+} tqueue_t;
+
+/**
+ * struct tslot_s - Per-thread handle on the buffer being filled; the switch
+ *                  to the locked mode reaches every live thread's buffer
+ *                  through these
+ *
+ * @lock: Held by the owner while it formats, and by whoever flushes the
+ *        buffer from another thread
+ * @buf:  Buffer being filled, or NULL
+ * @prev: Previous slot of the live slots list
+ * @next: Next slot of the live slots list
+ */
+typedef struct tslot_s
+{
+	pthread_mutex_t lock;
+	tbuf_t *buf;
+	struct tslot_s *prev;
+	struct tslot_s *next;
+} tslot_t;
+
+static tqueue_t queue;
+/* Placeholder keeping the queue non-empty */
+static tbuf_t queue_stub;
+static atomic_int buffered;
+static pthread_t writer;
+static pthread_key_t tslot_key;
+static pthread_once_t queue_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t mode_lock = PTHREAD_MUTEX_INITIALIZER;
+static tslot_t *slots;
+static pthread_mutex_t slots_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread tslot_t *tls_slot;
+
+/**
+ * tqueue_push - Pushes a buffer to the writer queue; wait-free
+ *
+ * @buf: Buffer to push
+ */
+static void tqueue_push(tbuf_t *buf)
+{
+	tbuf_t *prev;
+
+	atomic_store_explicit(&buf->next, NULL, memory_order_relaxed);
+	prev = atomic_exchange_explicit(&queue.head, buf, memory_order_acq_rel);
+	atomic_store_explicit(&prev->next, buf, memory_order_release);
+	if (buf != &queue_stub)
+		sem_post(&queue.ready);
+}
+
+/**
+ * tqueue_pop - Pops the oldest buffer of the writer queue
+ *
+ * Return: Buffer, or NULL if a producer has not finished linking it yet
+ */
+static tbuf_t *tqueue_pop(void)
+{
+	tbuf_t *tail = queue.tail, *next;
+
+	next = atomic_load_explicit(&tail->next, memory_order_acquire);
+	if (tail == &queue_stub)
+	{
+		if (!next)
+			return (NULL);
+		queue.tail = tail = next;
+		next = atomic_load_explicit(&next->next, memory_order_acquire);
+	}
+	if (next)
+	{
+		queue.tail = next;
+		return (tail);
+	}
+	if (tail != atomic_load_explicit(&queue.head, memory_order_acquire))
+		return (NULL);
+	tqueue_push(&queue_stub);
+	next = atomic_load_explicit(&tail->next, memory_order_acquire);
+	if (!next)
+		return (NULL);
+	queue.tail = next;
+	return (tail);
+}
+
+/**
+ * writer_thread - Writes the buffers handed off by the other threads
+ *
+ * @arg: Unused
+ *
+ * Return: NULL
+ */
+static void *writer_thread(void *arg)
+{
+	tbuf_t *buf;
+	int stop = 0;
+
+	(void)arg;
+	while (!stop)
+	{
+		sem_wait(&queue.ready);
+		/* A producer may be between its two stores */
+		while (!(buf = tqueue_pop()))
+			sched_yield();
+		fwrite(buf->data, 1, buf->len, stdout);
+		if (buf->done || buf->stop)
+			fflush(stdout);
+		stop = buf->stop;
+		if (buf->done)
+			sem_post(buf->done);
+		else if (!stop)
+			free(buf);
+	}
+	return (NULL);
+}
+
+/**
+ * tbuf_push - Hands a buffer to the writer thread, or frees it if empty
+ *
+ * @buf: Buffer, or NULL
+ */
+static void tbuf_push(tbuf_t *buf)
+{
+	if (buf && buf->len)
+		tqueue_push(buf);
+	else
+		free(buf);
+}
+
+/**
+ * tbuf_write - Writes a buffer out directly, in the locked mode, and frees
+ *              it
+ *
+ * @buf: Buffer, or NULL
+ */
+static void tbuf_write(tbuf_t *buf)
+{
+	if (buf && buf->len)
+	{
+		pthread_mutex_lock(&tprintf_mutex);
+		fwrite(buf->data, 1, buf->len, stdout);
+		pthread_mutex_unlock(&tprintf_mutex);
+	}
+	free(buf);
+}
+
+/**
+ * tbuf_alloc - Allocates an empty buffer
+ *
+ * @need: Minimum capacity
+ *
+ * Return: The buffer, or NULL
+ */
+static tbuf_t *tbuf_alloc(size_t need)
+{
+	size_t cap = need > TPRINTF_BUF_SIZE ? need : TPRINTF_BUF_SIZE;
+	tbuf_t *buf = malloc(sizeof(*buf) + cap);
+
+	if (!buf)
+		return (NULL);
+	buf->done = NULL;
+	buf->stop = 0;
+	buf->cap = cap;
+	buf->len = 0;
+	return (buf);
+}
+
+/**
+ * tslot_exit - Thread-specific data destructor: flushes the buffer of an
+ *              exiting thread and forgets its slot
+ *
+ * @arg: Slot of the thread
+ */
+static void tslot_exit(void *arg)
+{
+	tslot_t *slot = arg;
+	tbuf_t *buf;
+
+	tls_slot = NULL;
+	pthread_mutex_lock(&slot->lock);
+	buf = slot->buf;
+	slot->buf = NULL;
+	if (atomic_load(&buffered))
+	{
+		tbuf_push(buf);
+		buf = NULL;
+	}
+	pthread_mutex_unlock(&slot->lock);
+	tbuf_write(buf);
+	pthread_mutex_lock(&slots_lock);
+	if (slot->prev)
+		slot->prev->next = slot->next;
+	else
+		slots = slot->next;
+	if (slot->next)
+		slot->next->prev = slot->prev;
+	pthread_mutex_unlock(&slots_lock);
+	pthread_mutex_destroy(&slot->lock);
+	free(slot);
+}
+
+/**
+ * tslot_get - Gives the slot of the calling thread, registering it first
+ *
+ * Return: The slot, or NULL
+ */
+static tslot_t *tslot_get(void)
+{
+	tslot_t *slot = tls_slot;
+
+	if (slot)
+		return (slot);
+	slot = calloc(1, sizeof(*slot));
+	if (!slot)
+		return (NULL);
+	pthread_mutex_init(&slot->lock, NULL);
+	pthread_mutex_lock(&slots_lock);
+	slot->next = slots;
+	if (slots)
+		slots->prev = slot;
+	slots = slot;
+	pthread_mutex_unlock(&slots_lock);
+	tls_slot = slot;
+	pthread_setspecific(tslot_key, slot);
+	return (slot);
+}
+
+/**
+ * tbuf_format - Formats a line at the end of a buffer, if it fits
+ *
+ * @buf:    Buffer
+ * @format: Format string
+ * @args:   Arguments
+ *
+ * Return: Length of the line; it was only written if lower than the room
+ * left in the buffer
+ */
+static int tbuf_format(tbuf_t *buf, char const *format, va_list args)
+{
+	size_t room = buf->cap - buf->len;
+	int prefix, len;
+	va_list copy;
+
+	prefix = snprintf(buf->data + buf->len, room, "[%lu] ",
+			  (unsigned long)pthread_self());
+	va_copy(copy, args);
+	if ((size_t)prefix < room)
+		len = vsnprintf(buf->data + buf->len + prefix, room - prefix,
+				format, copy);
+	else
+		len = vsnprintf(NULL, 0, format, copy);
+	va_end(copy);
+	if (len >= 0 && (size_t)(prefix + len) < buf->cap - buf->len)
+		buf->len += prefix + len;
+	return (len < 0 ? len : prefix + len);
+}
+
+/**
+ * vtprintf_locked - Prints a line under tprintf_mutex, as the locked mode
+ *                   does
+ *
+ * @format: Format string
+ * @args:   Arguments
+ *
+ * Return: Number of characters printed
+ */
+static int vtprintf_locked(char const *format, va_list args)
+{
+	int ret;
+
+	pthread_mutex_lock(&tprintf_mutex);
+	ret = printf("[%lu] ", (unsigned long)pthread_self());
+	ret += vprintf(format, args);
+	pthread_mutex_unlock(&tprintf_mutex);
+	return (ret);
+}
+
+/**
+ * vtprintf_buffered - Formats a line into the calling thread's buffer.
+ *                     Full buffers are handed to the writer thread, and a
+ *                     line is never split across buffers.
+ *
+ * @format: Format string
+ * @args:   Arguments
+ *
+ * Return: Number of characters formatted, or -1
+ */
+int vtprintf_buffered(char const *format, va_list args)
+{
+	tslot_t *slot = tslot_get();
+	tbuf_t *buf;
+	size_t len;
+	int ret = -1;
+
+	if (!slot)
+		return (-1);
+	pthread_mutex_lock(&slot->lock);
+	buf = slot->buf;
+	if (!atomic_load(&buffered))
+	{
+		/* Switched off meanwhile: pending lines first, then this one */
+		slot->buf = NULL;
+		pthread_mutex_unlock(&slot->lock);
+		tbuf_write(buf);
+		return (vtprintf_locked(format, args));
+	}
+	if (buf || (buf = slot->buf = tbuf_alloc(0)))
+	{
+		len = buf->len;
+		ret = tbuf_format(buf, format, args);
+		if (ret >= 0 && buf->len == len)
+		{
+			/* Full: the line goes into a buffer it fits in */
+			tbuf_push(buf);
+			buf = slot->buf = tbuf_alloc(ret + 1);
+			ret = buf ? tbuf_format(buf, format, args) : -1;
+		}
+	}
+	pthread_mutex_unlock(&slot->lock);
+	return (ret);
+}
+
+/**
+ * tprintf_flush - Writes out the lines of the calling thread and waits
+ *                 until every buffer already handed off has been written
+ */
+void tprintf_flush(void)
+{
+	tslot_t *slot = atomic_load(&buffered) ? tslot_get() : NULL;
+	tbuf_t marker;
+	sem_t done;
+	int pushed = 0;
+
+	if (slot)
+	{
+		sem_init(&done, 0, 0);
+		marker.done = &done;
+		marker.stop = 0;
+		marker.cap = marker.len = 0;
+		/* The switch to the locked mode waits for this slot */
+		pthread_mutex_lock(&slot->lock);
+		pushed = atomic_load(&buffered);
+		if (pushed)
+		{
+			tbuf_push(slot->buf);
+			slot->buf = NULL;
+			tqueue_push(&marker);
+		}
+		pthread_mutex_unlock(&slot->lock);
+		if (pushed)
+			sem_wait(&done);
+		sem_destroy(&done);
+	}
+	if (!pushed)
+	{
+		/* Waits for a switch to the locked mode to be over */
+		pthread_mutex_lock(&tprintf_mutex);
+		fflush(stdout);
+		pthread_mutex_unlock(&tprintf_mutex);
+	}
+}
+
+/**
+ * tqueue_init - Initializes the writer queue, once
+ */
+static void tqueue_init(void)
+{
+	atomic_store(&queue_stub.next, NULL);
+	atomic_store(&queue.head, &queue_stub);
+	queue.tail = &queue_stub;
+	sem_init(&queue.ready, 0, 0);
+	pthread_key_create(&tslot_key, tslot_exit);
+}
+
+/**
+ * tprintf_unbuffer - Switches to the locked mode. Under tprintf_mutex, so
+ *                    that no line is printed directly in the meantime, it
+ *                    hands every thread's buffer to the writer thread, then
+ *                    stops the writer once it has drained the queue.
+ */
+static void tprintf_unbuffer(void)
+{
+	tslot_t *slot;
+	tbuf_t stop;
+
+	pthread_mutex_lock(&tprintf_mutex);
+	atomic_store(&buffered, 0);
+	pthread_mutex_lock(&slots_lock);
+	for (slot = slots; slot; slot = slot->next)
+	{
+		pthread_mutex_lock(&slot->lock);
+		tbuf_push(slot->buf);
+		slot->buf = NULL;
+		pthread_mutex_unlock(&slot->lock);
+	}
+	pthread_mutex_unlock(&slots_lock);
+	stop.done = NULL;
+	stop.stop = 1;
+	stop.cap = stop.len = 0;
+	tqueue_push(&stop);
+	pthread_join(writer, NULL);
+	pthread_mutex_unlock(&tprintf_mutex);
+}
+
+/**
+ * tprintf_set_buffered - Switches tprintf between its locked mode, which
+ *                        prints each line under tprintf_mutex, and its
+ *                        buffered mode, where each thread formats into its
+ *                        own buffer and a writer thread does the output.
+ *                        Buffers are flushed when full, on tprintf_flush, at
+ *                        thread exit and when the mode is switched off
+ *                        (including at process exit).
+ *
+ * @enable: 1 to buffer, 0 to go back to the locked mode
+ *
+ * Return: 0 on success, -1 if the writer thread could not be started
+ */
+int tprintf_set_buffered(int enable)
+{
+	int ret = 0;
+
+	pthread_once(&queue_once, tqueue_init);
+	pthread_mutex_lock(&mode_lock);
+	if (enable && !atomic_load(&buffered))
+	{
+		if (pthread_create(&writer, NULL, writer_thread, NULL))
+			ret = -1;
+		else
+			atomic_store(&buffered, 1);
+	}
+	else if (!enable && atomic_load(&buffered))
+		tprintf_unbuffer();
+	pthread_mutex_unlock(&mode_lock);
+	return (ret);
+}
+
+/**
+ * tprintf_is_buffered - Tells whether tprintf runs in buffered mode
+ *
+ * Return: 1 if it does, 0 otherwise
+ */
+int tprintf_is_buffered(void)
+{
+	return (atomic_load_explicit(&buffered, memory_order_relaxed));
+}
+
+/**
+ * tprintf_buffered_exit - Flushes every buffer handed off before exit
+ */
+__attribute__((destructor)) static void tprintf_buffered_exit(void)
+{
+	tprintf_set_buffered(0);
+}
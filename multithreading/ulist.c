@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include "ulist.h"
+
+/**
+ * ulist_init - Initializes an unrolled list
+ *
+ * @list: Pointer to the list to initialize
+ *
+ * Return: A pointer to the list
+ */
+ulist_t *ulist_init(ulist_t *list)
+{
+	list->head = NULL;
+	list->tail = NULL;
+	list->size = 0;
+	return (list);
+}
+
+/**
+ * ulist_add - Adds a content to the back of an unrolled list, allocating a
+ *             chunk when the back one is full
+ *
+ * @list:    Pointer to the list
+ * @content: Address of the custom content to store
+ *
+ * Return: A pointer to the slot holding the content, or NULL
+ */
+void **ulist_add(ulist_t *list, void *content)
+{
+	ulist_chunk_t *chunk = list->tail;
+
+	if (!chunk || chunk->count == ULIST_CHUNK)
+	{
+		chunk = malloc(sizeof(*chunk));
+		if (!chunk)
+			return (NULL);
+		chunk->next = NULL;
+		chunk->count = 0;
+		if (list->tail)
+			list->tail->next = chunk;
+		else
+			list->head = chunk;
+		list->tail = chunk;
+	}
+	chunk->items[chunk->count] = content;
+	++list->size;
+	return (&chunk->items[chunk->count++]);
+}
+
+/**
+ * ulist_destroy - Destroys the content of an unrolled list
+ *
+ * @list:      Pointer to the list
+ * @free_func: Pointer to a function to use to free each content, or NULL
+ */
+void ulist_destroy(ulist_t *list, node_func_t free_func)
+{
+	ulist_chunk_t *chunk, *next;
+	size_t i;
+
+	for (chunk = list->head; chunk; chunk = next)
+	{
+		for (i = 0; free_func && i < chunk->count; i++)
+			free_func(chunk->items[i]);
+		next = chunk->next;
+		free(chunk);
+	}
+	ulist_init(list);
+}
+
+/**
+ * ulist_each - Iterates over an unrolled list and calls a function for each
+ *              content, front to back
+ *
+ * @list: Pointer to the list
+ * @func: Pointer to a function to call with each content
+ */
+void ulist_each(ulist_t const *list, node_func_t func)
+{
+	ulist_chunk_t const *chunk;
+	size_t i;
+
+	for (chunk = list->head; chunk; chunk = chunk->next)
+		for (i = 0; i < chunk->count; i++)
+			func(chunk->items[i]);
+}
+
+/**
+ * ulist_iter_init - Positions an iterator at the front of an unrolled list
+ *
+ * @iter: Iterator
+ * @list: Pointer to the list
+ */
+void ulist_iter_init(ulist_iter_t *iter, ulist_t const *list)
+{
+	iter->chunk = list->head;
+	iter->i = 0;
+}
+
+/**
+ * ulist_next - Reads the next content of an unrolled list
+ *
+ * @iter:    Iterator
+ * @content: Where to store the content
+ *
+ * Return: 1 if a content was read, 0 at the end of the list
+ */
+int ulist_next(ulist_iter_t *iter, void **content)
+{
+	while (iter->chunk && iter->i == iter->chunk->count)
+	{
+		iter->chunk = iter->chunk->next;
+		iter->i = 0;
+	}
+	if (!iter->chunk)
+		return (0);
+	*content = iter->chunk->items[iter->i++];
+	return (1);
+}
@@ -0,0 +1,60 @@
+#ifndef ULIST_H
+#define ULIST_H
+
+#include <stddef.h>
+#include "list.h"
+
+/* Content pointers per chunk, so that a chunk spans 512 bytes */
+#define ULIST_CHUNK 62
+
+/**
+ * struct ulist_chunk_s - Block of consecutive contents of an unrolled list
+ *
+ * @next:  Next chunk
+ * @count: Number of contents stored in the chunk
+ * @items: Contents
+ */
+typedef struct ulist_chunk_s
+{
+	struct ulist_chunk_s	*next;
+	size_t			count;
+	void			*items[ULIST_CHUNK];
+} ulist_chunk_t;
+
+/**
+ * struct ulist_s - Unrolled list: a list_t storing up to ULIST_CHUNK
+ *                  contents per node, so a traversal takes one pointer
+ *                  hop (and one cache miss) per chunk instead of per content
+ *
+ * @head: Pointer to the front chunk
+ * @tail: Pointer to the back chunk
+ * @size: Number of contents in the list
+ */
+typedef struct ulist_s
+{
+	ulist_chunk_t	*head;
+	ulist_chunk_t	*tail;
+	size_t		size;
+} ulist_t;
+
+/**
+ * struct ulist_iter_s - Position in an unrolled list
+ *
+ * @chunk: Current chunk
+ * @i:     Index of the next content in the chunk
+ */
+typedef struct ulist_iter_s
+{
+	ulist_chunk_t const	*chunk;
+	size_t			i;
+} ulist_iter_t;
+
+/* ulist.c */
+ulist_t	*ulist_init(ulist_t *list);
+void	**ulist_add(ulist_t *list, void *content);
+void	ulist_destroy(ulist_t *list, node_func_t free_func);
+void	ulist_each(ulist_t const *list, node_func_t func);
+void	ulist_iter_init(ulist_iter_t *iter, ulist_t const *list);
+int	ulist_next(ulist_iter_t *iter, void **content);
+
+#endif /* ULIST_H */
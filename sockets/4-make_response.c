@@ -1,3 +1,4 @@
+#include "sockets.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -5,15 +6,22 @@
  * make_response - creates a response to a request
  *
  * @address: client adress to respond to (only needed for printing purposes)
- * @request: buffer containing request from address
+ * @request: request from address, as parsed by the server
+ * @len: length of the request
  * Return: response string
  */
-char *make_response(char *address, char *request)
+char *make_response(char *address, http_request_t *request, size_t len)
 {
+	char const *buf = request->raw_request;
+	size_t target_len = request->uri.len +
+		(request->query.off ? request->query.len + 1 : 0);
+
 	printf("Client connected: %s\n", address);
-	printf("Raw request: \"%s\"\n", request);
-	printf("Method: %s\n", strtok(request, " "));
-	printf("Path: %s\n", strtok(NULL, " "));
-	printf("Version: %s\n", strtok(NULL, "\r\n"));
+	printf("Raw request: \"%.*s\"\n", (int)len, buf);
+	printf("Method: %.*s\n", (int)request->method_str.len,
+	       buf + request->method_str.off);
+	printf("Path: %.*s\n", (int)target_len, buf + request->uri.off);
+	printf("Version: %.*s\n", (int)request->version.len,
+	       buf + request->version.off);
 	return (strdup("HTTP/1.1 200 OK\r\n\r\n"));
 }
@@ -1,3 +1,4 @@
+#include "sockets.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -5,35 +6,37 @@
 /**
  * print_path_and_queries - helper for take_requests()
  *
- * @buffer: buffer containing client request
+ * @request: parsed client request
  */
-static void print_path_and_queries(char *buffer)
+void print_path_and_queries(http_request_t const *request)
 {
-	char *path, *key, *value;
+	char const *buf = request->raw_request;
+	http_param_t const *param;
+	size_t i;
 
-	path = strtok(strtok(strchr(buffer, ' ') + 1, " "), "?");
+	printf("Path: %.*s\n", (int)request->uri.len, buf + request->uri.off);
 
-	printf("Path: %s\n", path);
-
-	for (
-		key = strtok(NULL, "="), value = strtok(NULL, "&/");
-		key && value;
-		key = strtok(NULL, "="), value = strtok(NULL, "&/")
-	)
-		printf("Query: \"%s\" -> \"%s\"\n", key, value);
+	for (i = 0; i < request->query_count; i++)
+	{
+		param = request->query_params + i;
+		printf("Query: \"%.*s\" -> \"%.*s\"\n", (int)param->key.len,
+		       buf + param->key.off, (int)param->value.len,
+		       buf + param->value.off);
+	}
 }
 
 /**
  * make_response - creates response to a request
  *
  * @address: adress to respond to (only needed for info printing purposes)
- * @request: buffer containing request from address
+ * @request: request from address, as parsed by the server
+ * @len: length of the request
  * Return: response
  */
-char *make_response(char *address, char *request)
+char *make_response(char *address, http_request_t *request, size_t len)
 {
 	printf("Client connected: %s\n", address);
-	printf("Raw request: \"%s\"\n", request);
+	printf("Raw request: \"%.*s\"\n", (int)len, request->raw_request);
 	print_path_and_queries(request);
 	fflush(stdout);
 	return (strdup("HTTP/1.1 200 OK\r\n\r\n"));
@@ -1,21 +1,23 @@
+#include "sockets.h"
 #include <stdio.h>
 #include <string.h>
 
 /**
  * print_headers - helper for take_requests()
- * @buffer: buffer containing client request
+ * @request: parsed client request
  */
-static void print_headers(char *buffer)
+void print_headers(http_request_t const *request)
 {
-	char *headers = strchr(buffer, '\n') + 1;
-	char *header  = strtok(headers, ":");
-	char *value   = strtok(NULL, "\r");
+	char const *buf = request->raw_request;
+	http_header_t const *header;
+	size_t i;
 
-	while (header && value)
+	for (i = 0; i < request->header_count; i++)
 	{
-		printf("Header: \"%s\" -> \"%s\"\n", header + (*header == '\n'), ++value);
-		header = strtok(NULL, ":");
-		value = strtok(NULL, "\r");
+		header = request->headers + i;
+		printf("Header: \"%.*s\" -> \"%.*s\"\n", (int)header->field.len,
+		       buf + header->field.off, (int)header->value.len,
+		       buf + header->value.off);
 	}
 
 }
@@ -24,13 +26,14 @@ static void print_headers(char *buffer)
  * make_response - creates response to a request
  *
  * @address: adress to respond to (only needed for info printing purposes)
- * @request: buffer containing request from address
+ * @request: request from address, as parsed by the server
+ * @len: length of the request
  * Return: response
  */
-char *make_response(char *address, char *request)
+char *make_response(char *address, http_request_t *request, size_t len)
 {
 	printf("Client connected: %s\n", address);
-	printf("Raw request: \"%s\"\n", request);
+	printf("Raw request: \"%.*s\"\n", (int)len, request->raw_request);
 	print_headers(request);
 	fflush(stdout);
 	return (strdup("HTTP/1.1 200 OK\r\n\r\n"));
@@ -11,13 +11,14 @@
 /**
  * make_response - responds to a request
  * @address: address to respond to
- * @request: adress's request
+ * @request: adress's request, as parsed by the server
+ * @len: length of the request
  * Return: response
  */
-char *make_response(char *address, char *request)
+char *make_response(char *address, http_request_t *request, size_t len)
 {
 	printf("Client connected: %s\n", address);
-	printf("Raw request: \"%s\"\n", request);
+	printf("Raw request: \"%.*s\"\n", (int)len, request->raw_request);
 	print_body_params(request);
 	fflush(stdout);
 	return (strdup(RES200));
@@ -27,20 +28,21 @@ char *make_response(char *address, char *request)
 /**
  * print_body_params - helper for take_requests()
  *
- * @request: request containing client request
+ * @request: parsed client request
  */
-void print_body_params(char *request)
+void print_body_params(http_request_t const *request)
 {
-	char *body_params = strstr(request, "\r\n\r\n") + 4;
-	char *path = strtok(strtok(strchr(request, ' ') + 1, " "), "?");
-	char *key, *value;
+	char const *buf = request->raw_request;
+	http_param_t const *param;
+	size_t i;
 
-	printf("Path: %s\n", path);
+	printf("Path: %.*s\n", (int)request->uri.len, buf + request->uri.off);
 
-	for (
-		key = strtok(body_params, "="), value = strtok(NULL, "&");
-		key && value;
-		key = strtok(NULL, "="), value = strtok(NULL, "&")
-	)
-		printf("Body param: \"%s\" -> \"%s\"\n", key, value);
+	for (i = 0; i < request->body_count; i++)
+	{
+		param = request->body_params + i;
+		printf("Body param: \"%.*s\" -> \"%.*s\"\n",
+		       (int)param->key.len, buf + param->key.off,
+		       (int)param->value.len, buf + param->value.off);
+	}
 }
@@ -4,7 +4,6 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include <unistd.h>
-#include "http_request_parser.c"
 #include "http_request_utils.c"
 #include "todos.c"
 
@@ -46,11 +45,14 @@ int known_uri(http_request_t *request)
 		OPTIONS_URIS,
 		TRACE_URIS
 	};
-	char **uris = uris_by_method[request->method];
+	char **uris;
 	size_t i;
 
+	if (request->method == UNKNOWN)
+		return (false);
+	uris = uris_by_method[request->method];
 	for (i = 0; uris[i]; i++)
-		if (!strcmp(request->uri, uris[i]))
+		if (span_equals(request->raw_request, request->uri, uris[i]))
 			return (true);
 
 	return (false);
@@ -68,21 +70,25 @@ int known_uri(http_request_t *request)
 size_t process_get_request(http_request_t *request, char **body, todo_t *todos,
 int sum_repr_lens, int id)
 {
-	char *delim, *tmp = get_param(request->query_params, "id");
+	http_span_t const *tmp = get_param(request, request->query_params,
+					   request->query_count, "id");
 	size_t length;
+	char *delim;
 	int i;
 
 	if (tmp)
 	{
-		i = atoi(tmp);
-		if (i >= id || !todos[i].repr)
+		/* Digits end at the '&' or ' ' delimiting the value */
+		i = atoi(request->raw_request + tmp->off);
+		if (i < 0 || i >= id || !todos[i].repr)
 			return (0);
 		*body = strdup(todos[i].repr);
 		length = todos[i].repr_len;
 	}
 	else
 	{
-		*body = malloc(sizeof(char) * (sum_repr_lens + 3));
+		/* Brackets, NUL, and a comma between two todos */
+		*body = malloc(sizeof(char) * (sum_repr_lens + id + 3));
 		**body = '[';
 		for (i = 0, length = 1, delim = ""; i < id; i++)
 			if (todos[i].repr)
@@ -108,15 +114,16 @@ int sum_repr_lens, int id)
 char *process_delete_request(http_request_t *request,
 todo_t *todos, int id, int *sum_repr_lens)
 {
-	char *tmp = get_param(request->query_params, "id");
+	http_span_t const *tmp = get_param(request, request->query_params,
+					   request->query_count, "id");
 	int i;
 
 	if (!tmp)
 		return (NULL);
 
-	i = atoi(tmp);
+	i = atoi(request->raw_request + tmp->off);
 
-	if (i >= id || !todos[i].repr)
+	if (i < 0 || i >= id || !todos[i].repr)
 		return (NULL);
 
 	*sum_repr_lens -= todos[i].repr_len;
@@ -133,9 +140,11 @@ todo_t *todos, int id, int *sum_repr_lens)
  */
 char *process_request(http_request_t *request)
 {
-	char *title, *description, *response, *body = NULL;
-	static todo_t todos[100];
-	static int id, sum_repr_lens;
+	http_span_t const *title, *description;
+	char *response, *body = NULL;
+	static todo_t *todos;
+	static int id, sum_repr_lens, capacity;
+	todo_t *grown;
 	size_t length;
 
 #ifdef TODO_API_7
@@ -149,13 +158,23 @@ char *process_request(http_request_t *request)
 	}
 	else
 	{
-		title = get_param(request->body_params, "title");
-		description = get_param(request->body_params, "description");
+		title = get_param(request, request->body_params,
+				  request->body_count, "title");
+		description = get_param(request, request->body_params,
+					request->body_count, "description");
 
 		if (!title || !description)
 			return (NULL);
 
-		add_todo(todos, id, title, description);
+		if (id == capacity)
+		{
+			grown = realloc(todos, sizeof(todo_t) * (id * 2 + 100));
+			if (!grown)
+				return (NULL);
+			todos = grown;
+			capacity = id * 2 + 100;
+		}
+		add_todo(todos, id, request->raw_request, *title, *description);
 		sum_repr_lens += todos[id].repr_len;
 		body = strdup(todos[id].repr);
 		length = todos[id].repr_len;
@@ -178,23 +197,23 @@ char *process_request(http_request_t *request)
 /**
  * make_response - responds to a request
  * @client_address: client address (ignored)
- * @buffer: buffer where client's request is stored.
+ * @request: request, as parsed by the server
+ * @len: length of the request (ignored)
  * Return: response
  */
-char *make_response(char *client_address, char *buffer)
+char *make_response(char *client_address, http_request_t *request,
+		    size_t len)
 {
-	char *method, *uri, *status, *res, *response = NULL;
-	struct http_request_s *request;
+	char const *buf = request->raw_request;
+	char *status, *res, *response = NULL;
 
 	(void)client_address;
+	(void)len;
 
-	request = http_request_init(buffer);
-	if (!request)
-		status = "400 Bad Request";
-	else if (!known_uri(request))
+	if (!known_uri(request))
 		status = "404 Not Found";
 	else if (request->method == POST &&
-		!get_header(request->headers, "Content-Length"))
+		!get_header(request, "Content-Length"))
 		status = "411 Length Required";
 	else
 	{
@@ -210,12 +229,14 @@ char *make_response(char *client_address, char *buffer)
 			status = "200 OK";
 	}
 
-	method = request ? request->method_str : strtok(buffer, " ");
-	uri = request ? request->uri : strtok(NULL, "? ");
-	printf("%s %s -> %s\n", method, uri, status);
-	res = calloc(1024, sizeof(char));
-	sprintf(res, "HTTP/1.1 %s\r\n%s", status, response ? response : "\r\n");
-	free_http_request(request);
+	printf("%.*s %.*s -> %s\n", (int)request->method_str.len,
+	       buf + request->method_str.off, (int)request->uri.len,
+	       buf + request->uri.off, status);
+	res = malloc(sizeof("HTTP/1.1 \r\n") + strlen(status) +
+		     (response ? strlen(response) : 2));
+	if (res)
+		sprintf(res, "HTTP/1.1 %s\r\n%s", status,
+			response ? response : "\r\n");
 	free(response);
 	return (res);
 }
@@ -0,0 +1,488 @@
+#include "sockets.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "http_parser.c"
+
+char *make_response(char *address, http_request_t *request, size_t len);
+
+#define WOULD_BLOCK() (errno == EAGAIN || errno == EWOULDBLOCK)
+
+/* make_response keeps the todos in statics */
+static pthread_mutex_t handler_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * clock_ms - reads the monotonic clock
+ *
+ * Return: time, in milliseconds
+ */
+static long clock_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec * 1000L + now.tv_nsec / 1000000L);
+}
+
+/**
+ * idle_unlink - removes a connection from the idle list of its loop
+ *
+ * @loop: event loop
+ * @conn: connection
+ */
+static void idle_unlink(event_loop_t *loop, conn_t *conn)
+{
+	if (conn->prev)
+		conn->prev->next = conn->next;
+	else if (loop->idle_head == conn)
+		loop->idle_head = conn->next;
+	if (conn->next)
+		conn->next->prev = conn->prev;
+	else if (loop->idle_tail == conn)
+		loop->idle_tail = conn->prev;
+	conn->prev = conn->next = NULL;
+}
+
+/**
+ * idle_touch - records activity on a connection, moving it to the end of
+ *              the idle list, which so stays sorted by time of last activity
+ *
+ * @loop: event loop
+ * @conn: connection
+ */
+static void idle_touch(event_loop_t *loop, conn_t *conn)
+{
+	conn->active = loop->now;
+	if (loop->idle_tail == conn)
+		return;
+	idle_unlink(loop, conn);
+	conn->prev = loop->idle_tail;
+	if (loop->idle_tail)
+		loop->idle_tail->next = conn;
+	else
+		loop->idle_head = conn;
+	loop->idle_tail = conn;
+}
+
+/**
+ * conn_close - closes a connection and frees its state
+ *
+ * @loop: event loop
+ * @conn: connection
+ */
+static void conn_close(event_loop_t *loop, conn_t *conn)
+{
+	idle_unlink(loop, conn);
+	close(conn->fd);
+	free(conn->in);
+	free(conn->out);
+	free(conn);
+}
+
+/**
+ * conn_shed - refuses a pending connection while the process is out of
+ *             descriptors: the spare descriptor is released to accept the
+ *             connection and close it at once, then reserved again
+ *
+ * @loop: event loop
+ * @server_id: non-blocking listening socket
+ * Return: 1 if a connection was shed, 0 once none is pending
+ */
+static int conn_shed(event_loop_t *loop, int server_id)
+{
+	int client_id;
+
+	if (loop->spare_fd == -1)
+	{
+		loop->accept_retry = 1;
+		return (0);
+	}
+	close(loop->spare_fd);
+	client_id = accept4(server_id, NULL, NULL, SOCK_CLOEXEC);
+	if (client_id != -1)
+		close(client_id);
+	else if (!WOULD_BLOCK())
+		loop->accept_retry = 1;
+	loop->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	return (client_id != -1);
+}
+
+/**
+ * conn_accept_error - handles a failed accept; under edge-triggered epoll,
+ *                     connections left pending wait for the next one to
+ *                     arrive, so accepting goes on past transient errors
+ *
+ * @loop: event loop
+ * @server_id: non-blocking listening socket
+ * Return: 1 to keep accepting, 0 to stop, -1 if the socket is unusable
+ */
+static int conn_accept_error(event_loop_t *loop, int server_id)
+{
+	if (WOULD_BLOCK())
+		return (0);
+	if (errno == EMFILE || errno == ENFILE)
+		return (conn_shed(loop, server_id));
+	if (errno == ENOBUFS || errno == ENOMEM)
+	{
+		perror("accept");
+		loop->accept_retry = 1;
+		return (0);
+	}
+	if (errno == EBADF || errno == EINVAL || errno == ENOTSOCK ||
+	    errno == EFAULT)
+		return (-1);
+	/* Aborted connection, or network error pending on it (accept(2)) */
+	return (1);
+}
+
+/**
+ * conn_open - accepts a pending connection and watches it for both reads
+ *             and writes, edge-triggered, so that it is never modified again
+ *
+ * @loop: event loop
+ * @server_id: non-blocking listening socket
+ * Return: 1 to keep accepting, 0 once none is pending or accepting must
+ *         wait, -1 if the listening socket is unusable
+ */
+static int conn_open(event_loop_t *loop, int server_id)
+{
+	struct sockaddr_in addr;
+	socklen_t addr_size = sizeof(addr);
+	struct epoll_event event;
+	conn_t *conn;
+	int client_id;
+
+	client_id = accept4(server_id, (struct sockaddr *)&addr, &addr_size,
+			    SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (client_id == -1)
+		return (conn_accept_error(loop, server_id));
+	conn = calloc(1, sizeof(*conn));
+	if (!conn)
+	{
+		perror("Connection");
+		return (close(client_id), 1);
+	}
+	conn->fd = client_id;
+	http_parser_init(&conn->parser);
+	inet_ntop(AF_INET, &addr.sin_addr, conn->address,
+		  sizeof(conn->address));
+	idle_touch(loop, conn);
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	event.data.ptr = conn;
+	if (epoll_ctl(loop->epoll_id, EPOLL_CTL_ADD, client_id, &event) == -1)
+	{
+		perror("epoll_ctl");
+		conn_close(loop, conn);
+	}
+	return (1);
+}
+
+/**
+ * conn_accept_all - accepts every pending connection
+ *
+ * @loop: event loop
+ * @server_id: non-blocking listening socket
+ */
+static void conn_accept_all(event_loop_t *loop, int server_id)
+{
+	int ret;
+
+	loop->accept_retry = 0;
+	do
+		ret = conn_open(loop, server_id);
+	while (ret > 0);
+	if (ret == -1)
+		perror("accept");
+}
+
+/**
+ * conn_read - reads everything a connection has received: with
+ *             edge-triggered events, the socket must be drained. Reading
+ *             stops early once CONN_MAX_REQUEST bytes wait to be served.
+ *
+ * @conn: connection
+ * Return: number of bytes read, or -1 on error
+ */
+static ssize_t conn_read(conn_t *conn)
+{
+	size_t cap = conn->in_cap ? conn->in_cap * 2 : CONN_READ_CHUNK * 2;
+	ssize_t n, total = 0;
+	char *in;
+
+	while (conn->in_len - conn->in_start < CONN_MAX_REQUEST)
+	{
+		if (conn->in_cap - conn->in_len < CONN_READ_CHUNK + 1 &&
+		    conn->in_start)
+		{
+			/* Drop the served requests rather than grow */
+			memmove(conn->in, conn->in + conn->in_start,
+				conn->in_len - conn->in_start);
+			conn->in_len -= conn->in_start;
+			conn->in_start = 0;
+		}
+		if (conn->in_cap - conn->in_len < CONN_READ_CHUNK + 1)
+		{
+			in = realloc(conn->in, cap);
+			if (!in)
+				return (-1);
+			conn->in = in, conn->in_cap = cap, cap *= 2;
+		}
+		n = recv(conn->fd, conn->in + conn->in_len,
+			 conn->in_cap - conn->in_len - 1, 0);
+		if (n > 0)
+			conn->in_len += n, total += n;
+		else if (!n)
+			return (conn->eof = true, total);
+		else if (errno != EINTR)
+			return (WOULD_BLOCK() ? total : -1);
+	}
+	return (total);
+}
+
+/**
+ * has_header - looks for a header field in the head of a response
+ *
+ * @res: response
+ * @end: end of the response headers
+ * @field: field name, colon included
+ * Return: true if the field is present, false otherwise
+ */
+static int has_header(char const *res, char const *end, char const *field)
+{
+	char const *line;
+
+	for (line = strstr(res, "\r\n"); line && line < end;
+	     line = strstr(line, "\r\n"))
+		if (!strncasecmp(line += 2, field, strlen(field)))
+			return (true);
+	return (false);
+}
+
+/**
+ * conn_queue - appends a response of make_response to the output of a
+ *              connection, with the headers a persistent connection needs:
+ *              Content-Length: 0 if the body was delimited by the close,
+ *              and whether the connection stays open
+ *
+ * @conn: connection
+ * @res: response
+ * Return: 0 on success, -1 on failure
+ */
+static int conn_queue(conn_t *conn, char const *res)
+{
+	char const *rest = strstr(res, "\r\n"), *end = strstr(res, "\r\n\r\n");
+	char extra[64] = "", *out;
+	size_t cap, line_len, extra_len, rest_len;
+	int code = atoi(res + strcspn(res, " "));
+
+	if (!rest)
+		return (-1);
+	rest += 2;
+	if (code >= 200 && code != 204 && code != 304 &&
+	    !has_header(res, end ? end : rest, "Content-Length:"))
+		strcat(extra, "Content-Length: 0\r\n");
+	if (conn->state == CONN_CLOSING)
+		strcat(extra, "Connection: close\r\n");
+	else if (!conn->parser.minor)
+		strcat(extra, "Connection: keep-alive\r\n");
+	line_len = rest - res, extra_len = strlen(extra);
+	rest_len = strlen(rest);
+	cap = conn->out_cap ? conn->out_cap : CONN_READ_CHUNK;
+	while (cap < conn->out_len + line_len + extra_len + rest_len)
+		cap *= 2;
+	if (cap != conn->out_cap)
+	{
+		out = realloc(conn->out, cap);
+		if (!out)
+			return (-1);
+		conn->out = out, conn->out_cap = cap;
+	}
+	out = conn->out + conn->out_len;
+	memcpy(out, res, line_len);
+	memcpy(out + line_len, extra, extra_len);
+	memcpy(out + line_len + extra_len, rest, rest_len);
+	conn->out_len += line_len + extra_len + rest_len;
+	return (0);
+}
+
+/**
+ * conn_serve - hands the complete requests of a connection, as parsed,
+ *              to make_response, one worker at a time, and queues the
+ *              responses in request order. It stops after a request that
+ *              closes the connection, or while CONN_MAX_OUTPUT bytes of
+ *              responses are unsent. An invalid request is answered with
+ *              the error of the parser, and closes the connection.
+ *
+ * @conn: connection
+ * Return: number of requests served, or -1 on error
+ */
+static int conn_serve(conn_t *conn)
+{
+	http_parser_t *parser = &conn->parser;
+	char *req, *res, error[64];
+	int served = 0, ret;
+	size_t len;
+
+	while (conn->state == CONN_READING &&
+	       conn->out_len - conn->out_sent < CONN_MAX_OUTPUT)
+	{
+		req = conn->in + conn->in_start;
+		len = conn->in_len - conn->in_start;
+		ret = http_parse(parser, req, len);
+		if (!ret)
+			break;
+		if (ret == -1)
+		{
+			conn->state = CONN_CLOSING;
+			sprintf(error, "HTTP/1.1 %s\r\n\r\n", parser->error);
+			if (conn_queue(conn, error) == -1)
+				return (-1);
+			conn->in_start = conn->in_len;
+			served++;
+			break;
+		}
+		len = parser->head_len + parser->body_len;
+		pthread_mutex_lock(&handler_lock);
+		res = make_response(conn->address, &parser->request, len);
+		pthread_mutex_unlock(&handler_lock);
+		if (!parser->keep_alive)
+			conn->state = CONN_CLOSING;
+		if (!res || conn_queue(conn, res) == -1)
+			return (free(res), -1);
+		free(res);
+		served++;
+		conn->in_start += len;
+		http_parser_init(parser);
+	}
+	if (conn->in_start == conn->in_len)
+		conn->in_start = conn->in_len = 0;
+	return (served);
+}
+
+/**
+ * conn_write - sends as much of the responses as the socket takes
+ *
+ * @conn: connection
+ * Return: 1 once every response is sent, 0 if the socket is full,
+ *         -1 on error
+ */
+static int conn_write(conn_t *conn)
+{
+	ssize_t n;
+
+	while (conn->out_sent < conn->out_len)
+	{
+		n = send(conn->fd, conn->out + conn->out_sent,
+			 conn->out_len - conn->out_sent, MSG_NOSIGNAL);
+		if (n >= 0)
+			conn->out_sent += n;
+		else if (errno != EINTR)
+			return (WOULD_BLOCK() ? 0 : -1);
+	}
+	conn->out_len = conn->out_sent = 0;
+	return (1);
+}
+
+/**
+ * conn_handle - advances the state machine of a connection on an event:
+ *               reads what came, serves the complete requests and sends
+ *               their responses, for as long as that makes progress; the
+ *               connection closes once its last response is sent
+ *
+ * @loop: event loop
+ * @conn: connection
+ * @events: epoll events
+ */
+static void conn_handle(event_loop_t *loop, conn_t *conn, uint32_t events)
+{
+	int served, sent;
+	ssize_t got;
+
+	if (events & EPOLLERR)
+	{
+		conn_close(loop, conn);
+		return;
+	}
+	idle_touch(loop, conn);
+	do {
+		got = 0;
+		if (conn->state == CONN_READING && !conn->eof)
+			got = conn_read(conn);
+		served = got < 0 ? -1 : conn_serve(conn);
+		sent = served < 0 ? -1 : conn_write(conn);
+		/* A full socket resumes on the next EPOLLOUT */
+		if (!sent)
+			return;
+	} while (sent > 0 && (got > 0 || served > 0));
+	if (sent < 0 || conn->state == CONN_CLOSING || conn->eof)
+		conn_close(loop, conn);
+}
+
+/**
+ * event_loop_run - serves the connections of a listening socket in the
+ *                  calling thread, with non-blocking sockets and
+ *                  edge-triggered epoll, so that no client waits on another;
+ *                  connections idle for CONN_IDLE_TIMEOUT are closed, and
+ *                  a descriptor is kept in reserve to shed connections
+ *                  when the process runs out of them
+ *
+ * @server_id: listening socket
+ * Return: -1 on error, does not return otherwise
+ */
+int event_loop_run(int server_id)
+{
+	struct epoll_event event, events[EVENT_LOOP_MAX_EVENTS], *ev;
+	event_loop_t loop = {-1, 0, NULL, NULL, -1, 0};
+	int n, i, timeout;
+
+	loop.epoll_id = epoll_create1(EPOLL_CLOEXEC);
+	if (loop.epoll_id == -1)
+		return (-1);
+	loop.spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	event.events = EPOLLIN | EPOLLET;
+	event.data.ptr = NULL;
+	if (fcntl(server_id, F_SETFL, fcntl(server_id, F_GETFL) | O_NONBLOCK) ||
+	    epoll_ctl(loop.epoll_id, EPOLL_CTL_ADD, server_id, &event) == -1)
+		return (close(loop.spare_fd), close(loop.epoll_id), -1);
+	while (1)
+	{
+		/* Sleep until the least recently active connection times out */
+		timeout = -1;
+		if (loop.idle_head)
+		{
+			timeout = loop.idle_head->active + CONN_IDLE_TIMEOUT -
+				  clock_ms();
+			timeout = timeout < 0 ? 0 : timeout;
+		}
+		/* No new connection may come to trigger the listening socket */
+		if (loop.accept_retry &&
+		    (timeout < 0 || timeout > EVENT_LOOP_ACCEPT_RETRY))
+			timeout = EVENT_LOOP_ACCEPT_RETRY;
+		n = epoll_wait(loop.epoll_id, events, EVENT_LOOP_MAX_EVENTS,
+			       timeout);
+		if (n == -1 && errno != EINTR)
+			return (close(loop.spare_fd), close(loop.epoll_id), -1);
+		loop.now = clock_ms();
+		if (loop.accept_retry)
+			conn_accept_all(&loop, server_id);
+		for (i = 0; i < n; i++)
+		{
+			ev = &events[i];
+			if (ev->data.ptr)
+				conn_handle(&loop, ev->data.ptr, ev->events);
+			else
+				conn_accept_all(&loop, server_id);
+		}
+		while (loop.idle_head &&
+		       loop.idle_head->active + CONN_IDLE_TIMEOUT <= loop.now)
+			conn_close(&loop, loop.idle_head);
+	}
+}
@@ -0,0 +1,396 @@
+#include "sockets.h"
+#include <ctype.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+
+#define RES431 "431 Request Header Fields Too Large"
+
+/**
+ * parse_error - stops a parser on an error
+ *
+ * @parser: parser
+ * @status: status of the response to send
+ * Return: always -1
+ */
+static int parse_error(http_parser_t *parser, char const *status)
+{
+	parser->state = HP_ERROR;
+	parser->error = status;
+	return (-1);
+}
+
+/**
+ * is_tchar - tells whether a character may appear in a method or a header
+ *            field name (a token, RFC 7230 3.2.6)
+ *
+ * @c: character
+ * Return: true if it may, false otherwise
+ */
+static int is_tchar(unsigned char c)
+{
+	return (isalnum(c) || (c && strchr("!#$%&'*+-.^_`|~", c)));
+}
+
+/**
+ * parse_length - reads the value of a Content-Length header
+ *
+ * @parser: parser
+ * @value: value
+ * @len: length of the value
+ * Return: 0 on success, -1 on error
+ */
+static int parse_length(http_parser_t *parser, char const *value, size_t len)
+{
+	size_t length = 0, i;
+
+	if (!len)
+		return (parse_error(parser, "400 Bad Request"));
+	for (i = 0; i < len; i++)
+	{
+		if (!isdigit((unsigned char)value[i]))
+			return (parse_error(parser, "400 Bad Request"));
+		length = length * 10 + (value[i] - '0');
+		if (length > HTTP_MAX_BODY)
+			return (parse_error(parser, "413 Payload Too Large"));
+	}
+	if (parser->has_length && length != parser->body_len)
+		return (parse_error(parser, "400 Bad Request"));
+	parser->has_length = true;
+	parser->body_len = length;
+	return (0);
+}
+
+/**
+ * parse_connection - reads the options of a Connection header, a comma
+ *                    separated list
+ *
+ * @parser: parser
+ * @value: value
+ * @len: length of the value
+ */
+static void parse_connection(http_parser_t *parser, char const *value,
+size_t len)
+{
+	size_t i = 0, start;
+
+	while (i < len)
+	{
+		while (i < len && (value[i] == ',' || value[i] == ' ' ||
+				   value[i] == '\t'))
+			i++;
+		for (start = i; i < len && value[i] != ',' && value[i] != ' ' &&
+		     value[i] != '\t'; i++)
+			;
+		if (i - start == 5 && !strncasecmp(value + start, "close", 5))
+			parser->close = true;
+		else if (i - start == 10 &&
+			 !strncasecmp(value + start, "keep-alive", 10))
+			parser->keep = true;
+	}
+}
+
+/**
+ * parse_header - handles a complete header line, of which only the fields
+ *                framing the request matter here
+ *
+ * @parser: parser
+ * @buf: request
+ * Return: 0 on success, -1 on error
+ */
+static int parse_header(http_parser_t *parser, char const *buf)
+{
+	http_header_t *header = parser->request.headers +
+		parser->request.header_count++;
+	char const *name = buf + header->field.off, *value;
+	size_t name_len = header->field.len, value_len;
+
+	header->value.off = parser->mark;
+	header->value.len = parser->value_end - parser->mark;
+	value = buf + header->value.off;
+	value_len = header->value.len;
+	if (name_len == 14 && !strncasecmp(name, "Content-Length", 14))
+		return (parse_length(parser, value, value_len));
+	if (name_len == 17 && !strncasecmp(name, "Transfer-Encoding", 17))
+		return (parse_error(parser, "501 Not Implemented"));
+	if (name_len == 10 && !strncasecmp(name, "Connection", 10))
+		parse_connection(parser, value, value_len);
+	return (0);
+}
+
+/**
+ * parse_method - identifies the method of the request line
+ *
+ * @buf: request
+ * @len: length of the method, which starts the request
+ * Return: http_method_t (enum type describing request type (see sockets.h))
+ */
+static http_method_t parse_method(char const *buf, size_t len)
+{
+	char *method_strs[] = {
+		"GET",
+		"HEAD",
+		"POST",
+		"PUT",
+		"DELETE",
+		"CONNECT",
+		"OPTIONS",
+		"TRACE"
+	};
+	size_t i, size = sizeof(method_strs) / sizeof(*method_strs);
+
+	for (i = 0; i < size; i++)
+		if (strlen(method_strs[i]) == len &&
+		    !strncmp(buf, method_strs[i], len))
+			return (i);
+
+	return (UNKNOWN);
+}
+
+/**
+ * parse_params - slices key=value pairs, delimited by '&'s, into an array
+ *                of parameters; pairs missing their key or their value
+ *                are skipped
+ *
+ * @buf: request
+ * @str: slice of key value pairs
+ * @params: array of HTTP_MAX_PARAMS parameters
+ * Return: number of parameters
+ */
+static size_t parse_params(char const *buf, http_span_t str,
+			   http_param_t *params)
+{
+	size_t count = 0, pos = str.off, end = str.off + str.len, pair_end, eq;
+
+	while (pos < end && count < HTTP_MAX_PARAMS)
+	{
+		for (pair_end = pos; pair_end < end && buf[pair_end] != '&';
+		     pair_end++)
+			;
+		for (eq = pos; eq < pair_end && buf[eq] != '='; eq++)
+			;
+		if (eq > pos && eq + 1 < pair_end)
+		{
+			params[count].key.off = pos;
+			params[count].key.len = eq - pos;
+			params[count].value.off = eq + 1;
+			params[count].value.len = pair_end - eq - 1;
+			count++;
+		}
+		pos = pair_end + 1;
+	}
+
+	return (count);
+}
+
+/**
+ * parse_uri - slices the request URI into its path and its query, which it
+ *             splits into parameters
+ *
+ * @parser: parser
+ * @buf: request
+ */
+static void parse_uri(http_parser_t *parser, char const *buf)
+{
+	http_request_t *request = &parser->request;
+	size_t end = parser->pos;
+
+	request->uri.off = parser->mark;
+	request->uri.len = end - parser->mark;
+	if (!request->query.off) /* No '?' */
+		return;
+	request->uri.len = request->query.off - 1 - parser->mark;
+	request->query.len = end - request->query.off;
+	request->query_count = parse_params(buf, request->query,
+					    request->query_params);
+}
+
+/**
+ * parse_version - checks the HTTP version of the request line
+ *
+ * @parser: parser
+ * @buf: request
+ * Return: 0 on success, -1 on error
+ */
+static int parse_version(http_parser_t *parser, char const *buf)
+{
+	char const *version = buf + parser->mark;
+	size_t len = parser->pos - parser->mark;
+
+	if (len < 5 || strncmp(version, "HTTP/", 5))
+		return (parse_error(parser, "400 Bad Request"));
+	if (len != 8 || strncmp(version, "HTTP/1.", 7) ||
+	    !isdigit((unsigned char)version[7]))
+		return (parse_error(parser, "505 HTTP Version Not Supported"));
+	parser->minor = version[7] - '0';
+	parser->request.version.off = parser->mark;
+	parser->request.version.len = len;
+	return (0);
+}
+
+/**
+ * parse_byte - advances the parser over one byte of the request line or
+ *              headers
+ *
+ * @parser: parser
+ * @buf: request
+ * @c: byte at parser->pos
+ * Return: 0 on success, -1 on error
+ */
+static int parse_byte(http_parser_t *parser, char const *buf, unsigned char c)
+{
+	size_t pos = parser->pos;
+	http_header_t *header;
+
+	switch (parser->state)
+	{
+	case HP_METHOD:
+		if (c == ' ' && pos)
+		{
+			parser->request.method_str.len = pos;
+			parser->request.method = parse_method(buf, pos);
+			parser->mark = pos + 1;
+			parser->state = HP_URI;
+		}
+		else if (!is_tchar(c))
+			return (parse_error(parser, "400 Bad Request"));
+		break;
+	case HP_URI:
+		if (c == ' ' && pos > parser->mark)
+		{
+			parse_uri(parser, buf);
+			parser->mark = pos + 1;
+			parser->state = HP_VERSION;
+		}
+		else if (c <= ' ' || c == 0x7f)
+			return (parse_error(parser, "400 Bad Request"));
+		else if (c == '?' && !parser->request.query.off)
+			parser->request.query.off = pos + 1;
+		break;
+	case HP_VERSION:
+		if (c == '\r' || c == '\n')
+		{
+			if (parse_version(parser, buf))
+				return (-1);
+			parser->state = c == '\r' ? HP_LINE_LF : HP_HEADER;
+		}
+		break;
+	case HP_LINE_LF:
+	case HP_HEAD_LF:
+		if (c != '\n')
+			return (parse_error(parser, "400 Bad Request"));
+		parser->state = parser->state == HP_LINE_LF ? HP_HEADER :
+			HP_BODY;
+		break;
+	case HP_HEADER:
+		if (c == '\r' || c == '\n')
+			parser->state = c == '\r' ? HP_HEAD_LF : HP_BODY;
+		else if (!is_tchar(c)) /* Obsolete line folding included */
+			return (parse_error(parser, "400 Bad Request"));
+		else if (parser->request.header_count == HTTP_MAX_HEADERS)
+			return (parse_error(parser, RES431));
+		else
+		{
+			header = parser->request.headers +
+				parser->request.header_count;
+			header->field.off = pos;
+			parser->state = HP_NAME;
+		}
+		break;
+	case HP_NAME:
+		if (c == ':')
+		{
+			header = parser->request.headers +
+				parser->request.header_count;
+			header->field.len = pos - header->field.off;
+			parser->mark = parser->value_end = pos + 1;
+			parser->state = HP_VALUE;
+		}
+		else if (!is_tchar(c))
+			return (parse_error(parser, "400 Bad Request"));
+		break;
+	case HP_VALUE:
+		if (c == '\r' || c == '\n')
+		{
+			if (parse_header(parser, buf))
+				return (-1);
+			parser->state = c == '\r' ? HP_LINE_LF : HP_HEADER;
+		}
+		else if ((c < ' ' && c != '\t') || c == 0x7f)
+			return (parse_error(parser, "400 Bad Request"));
+		else if (c != ' ' && c != '\t')
+			parser->value_end = pos + 1;
+		else if (parser->mark == pos) /* Leading whitespace */
+			parser->mark = parser->value_end = pos + 1;
+		break;
+	default:
+		break;
+	}
+	return (0);
+}
+
+/**
+ * http_parser_init - prepares a parser for the next request
+ *
+ * @parser: parser
+ */
+void http_parser_init(http_parser_t *parser)
+{
+	http_request_t *request = &parser->request;
+
+	memset(parser, 0, offsetof(http_parser_t, request));
+	parser->state = HP_METHOD;
+	/* The arrays are only read up to their counts: leave them be */
+	memset(request, 0, offsetof(http_request_t, headers));
+	request->header_count = request->query_count = request->body_count = 0;
+	request->body.off = request->body.len = 0;
+}
+
+/**
+ * http_parse - parses a request as its bytes arrive, resuming where the
+ *              previous call stopped, so that no byte is read twice; the
+ *              body is not read, only waited for, Content-Length bytes,
+ *              then split into parameters
+ *
+ * @parser: parser
+ * @buf: request received so far; it may move between calls, as the parser
+ *       keeps only offsets
+ * @len: number of bytes received
+ * Return: 1 once the request is complete, its length being
+ *         parser->head_len + parser->body_len and its slices, of @buf, in
+ *         parser->request, 0 while it is not, -1 on error, with the status
+ *         to respond in parser->error
+ */
+int http_parse(http_parser_t *parser, char const *buf, size_t len)
+{
+	http_request_t *request;
+
+	if (parser->state == HP_ERROR)
+		return (-1);
+	while (parser->state < HP_BODY && parser->pos < len)
+	{
+		if (parser->pos >= HTTP_MAX_HEAD)
+			return (parse_error(parser, RES431));
+		if (parse_byte(parser, buf, buf[parser->pos]))
+			return (-1);
+		parser->pos++;
+	}
+	if (parser->state == HP_BODY && !parser->head_len)
+	{
+		parser->head_len = parser->pos;
+		parser->keep_alive = parser->minor ? !parser->close :
+			parser->keep && !parser->close;
+	}
+	if (parser->state == HP_BODY &&
+	    len - parser->head_len >= parser->body_len)
+	{
+		parser->state = HP_DONE;
+		request = &parser->request;
+		request->raw_request = buf;
+		request->body.off = parser->head_len;
+		request->body.len = parser->body_len;
+		request->body_count = parse_params(buf, request->body,
+						   request->body_params);
+	}
+	return (parser->state == HP_DONE);
+}
@@ -1,12 +1,19 @@
+#define _GNU_SOURCE /* accept4 */
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include "event_loop.c"
 
 #define PORT 8080
 
-char *make_response(char *address, char *request);
+#ifndef SERVER_WORKERS
+#define SERVER_WORKERS 1
+#endif
 
 /**
  * error_out - prints error, closes open file descriptors and exits
@@ -26,36 +33,73 @@ static void error_out(char *str, int *server_id, int *client_id)
 }
 
 /**
- * take_requests - accepts new connections, responds
+ * take_requests - serves the connections of the server socket, all at once
+ *                 in the event loop; a slow client delays no other
  * @server_id: server socket file descriptor
  *
  */
 void take_requests(int server_id)
 {
-	int client_id;
-	struct sockaddr_in client_addr;
-	socklen_t addr_size = sizeof(struct sockaddr);
-	char request[1024] = {0}, *response;
+	struct rlimit limit;
 
-	while (1)
+	/* One descriptor per connection: allow as many as the system does */
+	if (!getrlimit(RLIMIT_NOFILE, &limit))
 	{
-		client_id = accept(server_id, (struct sockaddr *)&client_addr, &addr_size);
-		if (client_id == -1)
-			error_out("Accept", &server_id, NULL);
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+	if (event_loop_run(server_id) == -1)
+		error_out("Event loop", &server_id, NULL);
+}
+
+/**
+ * server_open - opens a listening socket on PORT; with several workers,
+ *               each has its own, and SO_REUSEPORT lets the kernel spread
+ *               the connections over them. A single worker leaves it off,
+ *               so that a second server on PORT fails to bind.
+ *
+ * @shared: whether the workers share PORT
+ * Return: server socket file descriptor
+ */
+static int server_open(int shared)
+{
+	int server_id = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+	struct sockaddr_in addr;
+	int one = 1;
+
+	if (server_id == -1)
+		error_out("Socket", NULL, NULL);
 
+	/* The server closes first: restart despite its TIME_WAIT sockets */
+	setsockopt(server_id, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (shared && setsockopt(server_id, SOL_SOCKET, SO_REUSEPORT, &one,
+				 sizeof(one)) == -1)
+		error_out("SO_REUSEPORT", &server_id, NULL);
 
-		if (recv(client_id, request, sizeof(request), 0) == -1)
-			error_out("recv", &server_id, &client_id);
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
 
-		response = make_response(inet_ntoa(client_addr.sin_addr), request);
 
-		if (send(client_id, response, strlen(response), 0) == -1)
-			free(response), error_out("send", &server_id, &client_id);
+	if (bind(server_id, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+		error_out("Bind", &server_id, NULL);
 
-		close(client_id);
-		free(response);
-		memset(request, '\0', sizeof(request));
-	}
+	if (listen(server_id, SOMAXCONN) == -1)
+		error_out("Listen", &server_id, NULL);
+
+	return (server_id);
+}
+
+/**
+ * worker_entry - thread entry of a worker, running its own event loop
+ * @arg: server socket file descriptor of the worker, as an intptr_t
+ *
+ * Return: does not return
+ */
+static void *worker_entry(void *arg)
+{
+	take_requests((int)(intptr_t)arg);
+	return (NULL);
 }
 
 /**
@@ -109,24 +153,22 @@ void take_requests(int server_id)
  */
 int main(void)
 {
-	int server_id = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
-	struct sockaddr_in addr;
-
-	if (server_id == -1)
-		error_out("Socket", NULL, NULL);
-
-	addr.sin_family = AF_INET;
-	addr.sin_port = htons(PORT);
-	addr.sin_addr.s_addr = htonl(INADDR_ANY);
-
-
-	if (bind(server_id, (struct sockaddr *)&addr, sizeof(addr)) == -1)
-		error_out("Bind", &server_id, NULL);
-
-	if (listen(server_id, 1) == -1)
-		error_out("Listen", &server_id, NULL);
+	long workers = SERVER_WORKERS, i;
+	pthread_t thread;
+	int server_id;
 
+	if (workers < 1)
+		workers = sysconf(_SC_NPROCESSORS_ONLN);
 	setbuf(stdout, NULL);
+	for (i = 1; i < workers; i++)
+	{
+		server_id = server_open(1);
+		if (pthread_create(&thread, NULL, worker_entry,
+				   (void *)(intptr_t)server_id) ||
+		    pthread_detach(thread))
+			error_out("Worker", &server_id, NULL);
+	}
+	server_id = server_open(workers > 1);
 	printf("Server listening on port %d\n", PORT);
 	take_requests(server_id);
 	close(server_id);
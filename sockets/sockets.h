@@ -2,6 +2,7 @@
 #define _SOCKETS_H_
 
 #include <stdlib.h>
+#include <netinet/in.h> /* INET_ADDRSTRLEN */
 
 #define true 1
 #define false 0
@@ -222,65 +223,249 @@ typedef enum http_header_field_e
 	X_Frame_Options
 } http_header_field_t;
 
+/* Header lines and parameters kept of a request */
+#define HTTP_MAX_HEADERS 64
+#define HTTP_MAX_PARAMS 32
+
 /**
- * struct http_param_s - HTTP body parameter struct
+ * struct http_span_s - slice of a request, which it does not copy
+ * @off: offset of the first byte, from the start of the request
+ * @len: number of bytes
+ */
+typedef struct http_span_s
+{
+	size_t off;
+	size_t len;
+} http_span_t;
+
+/**
+ * struct http_param_s - HTTP query or body parameter struct
  * @key: parameter key
  * @value: parameter value
- * @next: pointer to next HTTP body parameter struct
  */
 typedef struct http_param_s
 {
-	char *key;
-	char *value;
-	struct http_param_s *next;
+	http_span_t key;
+	http_span_t value;
 } http_param_t;
 
 /**
  * struct http_header_s - HTTP header struct
- * @field: HTTP header field enum
- * @value: pointer to value of field
- * @next: pointer to next HTTP header struct
+ * @field: header field name
+ * @value: header field value, without the surrounding whitespace
  */
 typedef struct http_header_s
 {
-	char *field;
-	char *value;
-	struct http_header_s *next;
+	http_span_t field;
+	http_span_t value;
 } http_header_t;
 
 /**
- * struct http_request_s - struct describing an HTTP request
- * @raw_request: raw request
+ * struct http_request_s - struct describing an HTTP request, whose parts are
+ *                         slices of the request itself, so that parsing it
+ *                         allocates nothing
+ * @raw_request: raw request, which the slices refer to; it must outlive them
  * @method: HTTP method
- * @method_str: pointer to HTTP method string from original HTTP request
- * @uri: request URI
+ * @method_str: HTTP method string
+ * @uri: request URI, without its query
+ * @query: query of the request URI, after the '?'
  * @version: HTTP version (string)
- * @headers: linked list of http_header_t structs
- * @body: pointer to HTTP request body
- * @query_params: linked list of http_param_t structs passed via query
- * @body_params: linked list of http_param_t structs passed via body
+ * @headers: header lines, in request order
+ * @header_count: number of header lines
+ * @body: HTTP request body
+ * @query_params: parameters passed via query
+ * @query_count: number of parameters passed via query
+ * @body_params: parameters passed via body
+ * @body_count: number of parameters passed via body
  */
 typedef struct http_request_s
 {
-	char          *raw_request;
+	char const    *raw_request;
 	http_method_t  method;
-	char          *method_str;
-	char          *uri;
-	char          *version;
-	http_header_t *headers;
-	char          *body;
-	http_param_t  *query_params;
-	http_param_t  *body_params;
+	http_span_t    method_str;
+	http_span_t    uri;
+	http_span_t    query;
+	http_span_t    version;
+	http_header_t  headers[HTTP_MAX_HEADERS];
+	size_t         header_count;
+	http_span_t    body;
+	http_param_t   query_params[HTTP_MAX_PARAMS];
+	size_t         query_count;
+	http_param_t   body_params[HTTP_MAX_PARAMS];
+	size_t         body_count;
 } http_request_t;
 
+/* Parser limits: request line and headers, body */
+#define HTTP_MAX_HEAD (64 << 10)
+#define HTTP_MAX_BODY (1 << 20)
+
+/**
+ * enum http_parse_state_e - state of a request parser, named after what it
+ *                           reads next
+ * @HP_METHOD: method
+ * @HP_URI: request URI
+ * @HP_VERSION: HTTP version, up to the end of the request line
+ * @HP_LINE_LF: LF ending a line
+ * @HP_HEADER: header line, or the empty line ending the headers
+ * @HP_NAME: header field name
+ * @HP_VALUE: header field value, up to the end of its line
+ * @HP_HEAD_LF: LF ending the headers
+ * @HP_BODY: body, Content-Length bytes long
+ * @HP_DONE: nothing, the request is complete
+ * @HP_ERROR: nothing, the request is invalid
+ */
+typedef enum http_parse_state_e
+{
+	HP_METHOD,
+	HP_URI,
+	HP_VERSION,
+	HP_LINE_LF,
+	HP_HEADER,
+	HP_NAME,
+	HP_VALUE,
+	HP_HEAD_LF,
+	HP_BODY,
+	HP_DONE,
+	HP_ERROR
+} http_parse_state_t;
+
+/**
+ * struct http_parser_s - incremental request parser, filling the slices of
+ *                        the request as each of its lines completes;
+ *                        offsets are from the start of the request
+ * @state: parser state
+ * @pos: offset of the next byte to parse
+ * @mark: offset where the token being read starts
+ * @value_end: offset past the last non-whitespace byte of the value
+ * @minor: minor version of HTTP/1.x
+ * @has_length: true if a Content-Length header came
+ * @close: true if a Connection header holds close
+ * @keep: true if a Connection header holds keep-alive
+ * @head_len: length of the request line and headers, 0 until they end
+ * @body_len: Content-Length of the request
+ * @keep_alive: true if the connection outlives the request
+ * @error: status of the response to an invalid request
+ * @request: request, complete once http_parse returns 1
+ */
+typedef struct http_parser_s
+{
+	http_parse_state_t  state;
+	size_t              pos;
+	size_t              mark;
+	size_t              value_end;
+	int                 minor;
+	int                 has_length;
+	int                 close;
+	int                 keep;
+	size_t              head_len;
+	size_t              body_len;
+	int                 keep_alive;
+	char const         *error;
+	http_request_t      request;
+} http_parser_t;
+
+/* Event loop: epoll events per wait, receive granularity, request limit */
+#define EVENT_LOOP_MAX_EVENTS 256
+#define CONN_READ_CHUNK 4096
+#define CONN_MAX_REQUEST (HTTP_MAX_HEAD + HTTP_MAX_BODY)
+/* Unsent responses past which pipelined requests wait */
+#define CONN_MAX_OUTPUT (1 << 20)
+/* Inactivity after which a connection is closed, in milliseconds */
+#ifndef CONN_IDLE_TIMEOUT
+#define CONN_IDLE_TIMEOUT 30000
+#endif
+/* Delay before accept is retried after running out of memory or descriptors */
+#define EVENT_LOOP_ACCEPT_RETRY 100
+
+/**
+ * enum conn_state_e - state of a connection served by the event loop
+ * @CONN_READING: reading requests, their responses sent as they are ready
+ * @CONN_CLOSING: sending the last responses, then closing
+ */
+typedef enum conn_state_e
+{
+	CONN_READING,
+	CONN_CLOSING
+} conn_state_t;
+
+/**
+ * struct conn_s - connection served by the event loop
+ * @fd: client socket file descriptor, non-blocking
+ * @state: connection state
+ * @address: client address, for make_response
+ * @in: received bytes
+ * @in_start: offset in @in of the request being read; those before it are
+ *            served
+ * @in_len: number of received bytes
+ * @in_cap: size of @in
+ * @parser: parser of the request being read
+ * @eof: true once the client shut down its side
+ * @out: responses, in request order
+ * @out_len: length of the responses
+ * @out_cap: size of @out
+ * @out_sent: bytes of the responses already sent
+ * @active: time of the last activity, in milliseconds
+ * @prev: previous connection of the idle list, less recently active
+ * @next: next connection of the idle list, more recently active
+ */
+typedef struct conn_s
+{
+	int           fd;
+	conn_state_t  state;
+	char          address[INET_ADDRSTRLEN];
+	char         *in;
+	size_t        in_start;
+	size_t        in_len;
+	size_t        in_cap;
+	http_parser_t parser;
+	int           eof;
+	char         *out;
+	size_t        out_len;
+	size_t        out_cap;
+	size_t        out_sent;
+	long          active;
+	struct conn_s *prev;
+	struct conn_s *next;
+} conn_t;
+
+/**
+ * struct event_loop_s - event loop of one worker
+ * @epoll_id: epoll instance
+ * @now: time of the last wakeup, in milliseconds
+ * @idle_head: least recently active connection, the next to time out
+ * @idle_tail: most recently active connection
+ * @spare_fd: descriptor kept in reserve, released to shed connections when
+ *            the process runs out of descriptors, or -1
+ * @accept_retry: whether connections may be left pending after an error
+ */
+typedef struct event_loop_s
+{
+	int     epoll_id;
+	long    now;
+	conn_t *idle_head;
+	conn_t *idle_tail;
+	int     spare_fd;
+	int     accept_retry;
+} event_loop_t;
+
 void   take_requests(int sockid);
-void   print_path_and_queries(char *buffer);
-void   print_headers(char *buffer);
-void   print_body_params(char *buffer);
+int    event_loop_run(int server_id);
+void   http_parser_init(http_parser_t *parser);
+int    http_parse(http_parser_t *parser, char const *buf, size_t len);
+void   print_path_and_queries(http_request_t const *request);
+void   print_headers(http_request_t const *request);
+void   print_body_params(http_request_t const *request);
 int    eval_request(char *buffer, int sockid, int client_id);
-char  *get_param(http_param_t *params, char *key);
-void   add_todo(todo_t *todos, int id, char *title, char *description);
-char  *make_repr(int id, char *title, char *description);
+http_span_t const *get_header(http_request_t const *request,
+			      char const *field);
+http_span_t const *get_param(http_request_t const *request,
+			     http_param_t const *params, size_t count,
+			     char const *key);
+int    span_equals(char const *buf, http_span_t span, char const *str);
+void   add_todo(todo_t *todos, int id, char const *buf, http_span_t title,
+		http_span_t description);
+char  *make_repr(int id, char const *buf, http_span_t title,
+		 http_span_t description);
 int    post(char *body, int id, int client_id, int sockid, todo_t *todos);
 
 
@@ -6,38 +6,43 @@
  * make_repr - makes repr
  *
  * @id: id
+ * @buf: request holding the title and description
  * @title: title
  * @description: description
  * Return: repr
  */
-char *make_repr(int id, char *title, char *description)
+char *make_repr(int id, char const *buf, http_span_t title,
+		http_span_t description)
 {
-#define DICT     "{\"id\":%d,\"title\":\"%s\",\"description\":\"%s\"}"
+#define DICT     "{\"id\":%d,\"title\":\"%.*s\",\"description\":\"%.*s\"}"
 
-	size_t len = strlen(title) + strlen(description) + strlen(DICT) + 10;
+	size_t len = title.len + description.len + strlen(DICT) + 10;
 	char *repr = malloc(sizeof(char) * len);
 
 	if (repr)
-		sprintf(repr, DICT, id, title, description);
+		sprintf(repr, DICT, id, (int)title.len, buf + title.off,
+			(int)description.len, buf + description.off);
 	return (repr);
 }
 
 
 /**
- * add_todo - adds todo item
+ * add_todo - adds todo item, copying its strings out of the request
  *
  * @todos: todos
  * @id: id
+ * @buf: request holding the title and description
  * @title: title
  * @description: description
  */
-void add_todo(todo_t *todos, int id, char *title, char *description)
+void add_todo(todo_t *todos, int id, char const *buf, http_span_t title,
+	      http_span_t description)
 {
 	todo_t *todo = todos + id;
 
 	todo->id = id;
-	todo->title = strdup(title);
-	todo->description = strdup(description);
-	todo->repr = make_repr(id, title, description);
+	todo->title = strndup(buf + title.off, title.len);
+	todo->description = strndup(buf + description.off, description.len);
+	todo->repr = make_repr(id, buf, title, description);
 	todo->repr_len = strlen(todo->repr);
 }